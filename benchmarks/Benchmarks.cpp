@@ -1,3 +1,4 @@
+#include "../tests/helpers/test_helpers.h"
 #include "PluginEditor.h"
 #include "catch2/benchmark/catch_benchmark_all.hpp"
 #include "catch2/catch_test_macros.hpp"
@@ -37,4 +38,117 @@ TEST_CASE ("Boot performance")
             return plugin.getActiveEditor();
         });
     };
+
+    // what a session load costs per instance: construction, prepare and the first block that
+    // touches all the fresh memory
+    for (auto sampleRate : { 44100.0, 48000.0, 96000.0, 192000.0 })
+    {
+        BENCHMARK_ADVANCED ("Constructor, prepareToPlay and first block at " + std::to_string ((int) sampleRate) + " Hz")
+        (Catch::Benchmark::Chronometer meter)
+        {
+            auto gui = juce::ScopedJuceInitialiser_GUI {};
+            // destroyed after the measurement
+            std::vector<std::unique_ptr<PluginProcessor>> plugins (size_t (meter.runs()));
+            juce::AudioBuffer<float> buffer (2, 512);
+            juce::MidiBuffer midi;
+            meter.measure ([&] (int i) {
+                auto& plugin = *(plugins[(size_t) i] = std::make_unique<PluginProcessor>());
+                plugin.prepareToPlay (sampleRate, 512);
+                buffer.clear();
+                plugin.processBlock (buffer, midi);
+            });
+        };
+    }
+
+    BENCHMARK_ADVANCED ("Re-prepare with the same settings")
+    (Catch::Benchmark::Chronometer meter)
+    {
+        auto gui = juce::ScopedJuceInitialiser_GUI {};
+        PluginProcessor plugin;
+        plugin.prepareToPlay (48000.0, 512);
+        meter.measure ([&] { plugin.prepareToPlay (48000.0, 512); });
+    };
+
+    BENCHMARK_ADVANCED ("Sample rate switch")
+    (Catch::Benchmark::Chronometer meter)
+    {
+        auto gui = juce::ScopedJuceInitialiser_GUI {};
+        PluginProcessor plugin;
+        plugin.prepareToPlay (48000.0, 512);
+        meter.measure ([&] (int i) { plugin.prepareToPlay (i % 2 == 0 ? 44100.0 : 48000.0, 512); });
+    };
+
+    // a dense cloud running behind the editor, the way it looks in a session
+    auto prepareCloud = [] (PluginProcessor& plugin) {
+        setParameter (plugin, "grainRate", 200.0f);
+        setParameter (plugin, "delayTime", 0.2f);
+        plugin.prepareToPlay (48000.0, 512);
+        plugin.setGrainCloudVisible (true);
+
+        juce::AudioBuffer<float> buffer (2, 512);
+        juce::MidiBuffer midi;
+        juce::Random random (42);
+        for (int block = 0; block < 100; block++)
+        {
+            for (int channel = 0; channel < buffer.getNumChannels(); channel++)
+                for (int i = 0; i < buffer.getNumSamples(); i++)
+                    buffer.setSample (channel, i, random.nextFloat() * 2.0f - 1.0f);
+            plugin.processBlock (buffer, midi);
+        }
+    };
+
+    BENCHMARK_ADVANCED ("Editor paint")
+    (Catch::Benchmark::Chronometer meter)
+    {
+        auto gui = juce::ScopedJuceInitialiser_GUI {};
+        PluginProcessor plugin;
+        prepareCloud (plugin);
+        std::unique_ptr<juce::AudioProcessorEditor> editor (plugin.createEditorIfNeeded());
+        dynamic_cast<PluginEditor&> (*editor).getGrainCloudView().refresh();
+        juce::Image image (juce::Image::ARGB, editor->getWidth(), editor->getHeight(), true);
+
+        // a full repaint, like when the window is first shown
+        meter.measure ([&] {
+            juce::Graphics g (image);
+            editor->paintEntireComponent (g, true);
+            return image.getPixelAt (0, 0);
+        });
+        plugin.editorBeingDeleted (editor.get());
+    };
+
+    BENCHMARK_ADVANCED ("Grain cloud frame")
+    (Catch::Benchmark::Chronometer meter)
+    {
+        auto gui = juce::ScopedJuceInitialiser_GUI {};
+        PluginProcessor plugin;
+        prepareCloud (plugin);
+        std::unique_ptr<juce::AudioProcessorEditor> editor (plugin.createEditorIfNeeded());
+        auto& view = dynamic_cast<PluginEditor&> (*editor).getGrainCloudView();
+        view.refresh();
+        juce::Image image (juce::Image::ARGB, view.getWidth(), view.getHeight(), true);
+
+        // one timer tick: a new snapshot, then only the dirty region gets painted. The snapshots are
+        // published straight into the triple buffer, so processBlock doesn't end up in the timing
+        const auto frame = plugin.getGrainCloud().getReadBuffer();
+        auto samplesPerFrame = (int) (frame.sampleRate / GrainCloudView::frameRate);
+        meter.measure ([&] (int i) {
+            auto& next = plugin.getGrainCloud().getWriteBuffer();
+            next = frame;
+            auto elapsed = (i % GrainCloudView::frameRate) * samplesPerFrame;
+            next.sampleTime += elapsed;
+            for (int grain = 0; grain < next.numGrains; grain++)
+            {
+                next.grains[(size_t) grain].age += elapsed;
+                next.grains[(size_t) grain].sourceDistance += elapsed;
+            }
+            plugin.getGrainCloud().publish();
+
+            auto dirty = view.refresh();
+            juce::Graphics g (image);
+            g.reduceClipRegion (dirty);
+            view.paintEntireComponent (g, true);
+            return dirty.getBounds().getWidth();
+        });
+        plugin.editorBeingDeleted (editor.get());
+    };
 }
@@ -0,0 +1,216 @@
+#include "../tests/helpers/test_helpers.h"
+#include "catch2/catch_test_macros.hpp"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+/* Throughput of PluginProcessor::processBlock over a matrix of grain density,
+ * envelope length, delay, feedback, block size, sample rate, precision and engine rate.
+ *
+ * Every configuration renders a fixed amount of noise and reports ns/sample,
+ * grains rendered per second and the realtime factor. The results also end up in
+ * processblock_benchmarks.json (or wherever LSP_BENCHMARK_JSON points),
+ * so two versions can be diffed. A dense cloud is also rendered with tracing on and dumped
+ * to processblock_trace.json (or LSP_TRACE_JSON) for chrome://tracing or ui.perfetto.dev.
+ */
+namespace
+{
+    struct Configuration
+    {
+        double sampleRate = 48000.0;
+        int blockSize = 512;
+        float grainRate = 20.0f;
+        float envelope = 10.0f; // attack, decay and release in ms
+        float delayTime = 0.5f;
+        float feedback = 0.5f;
+        bool doublePrecision = false;
+        // runs the engine at 44.1 or 48 kHz whatever the host rate
+        bool reducedRate = false;
+    };
+
+    struct Result
+    {
+        Configuration configuration;
+        double nsPerSample;
+        double grainsPerSecond;
+        double realtimeFactor;
+    };
+
+    constexpr double secondsToRender = 2.0;
+    constexpr double secondsToWarmUp = 0.5;
+
+    template <typename SampleType>
+    Result run (const Configuration& configuration)
+    {
+        PluginProcessor plugin;
+        plugin.setProcessingPrecision (configuration.doublePrecision ? juce::AudioProcessor::doublePrecision : juce::AudioProcessor::singlePrecision);
+        setParameter (plugin, "grainRate", configuration.grainRate);
+        setParameter (plugin, "grainAttack", configuration.envelope);
+        setParameter (plugin, "grainDecay", configuration.envelope);
+        setParameter (plugin, "grainRelease", configuration.envelope);
+        setParameter (plugin, "delayTime", configuration.delayTime);
+        setParameter (plugin, "feedback", configuration.feedback);
+        setParameter (plugin, "engineRate", configuration.reducedRate ? 1.0f : 0.0f);
+        plugin.prepareToPlay (configuration.sampleRate, configuration.blockSize);
+
+        juce::AudioBuffer<SampleType> input (2, configuration.blockSize);
+        juce::AudioBuffer<SampleType> buffer (2, configuration.blockSize);
+        juce::MidiBuffer midi;
+        juce::Random random (42);
+        for (int channel = 0; channel < input.getNumChannels(); channel++)
+            for (int i = 0; i < input.getNumSamples(); i++)
+                input.setSample (channel, i, (SampleType) (random.nextFloat() * 2.0f - 1.0f));
+
+        auto processBlocks = [&] (double seconds) {
+            auto numBlocks = (int) std::ceil (seconds * configuration.sampleRate / configuration.blockSize);
+            for (int block = 0; block < numBlocks; block++)
+            {
+                buffer.makeCopyOf (input, true);
+                plugin.processBlock (buffer, midi);
+            }
+            return numBlocks;
+        };
+
+        // let the delay line fill up so grains actually play
+        processBlocks (secondsToWarmUp + 2.0 * configuration.delayTime);
+
+        auto grainsBefore = plugin.getNumGrainsRendered();
+        auto start = std::chrono::steady_clock::now();
+        auto numBlocks = processBlocks (secondsToRender);
+        auto elapsed = std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+
+        auto numSamples = (double) numBlocks * configuration.blockSize;
+        return {
+            configuration,
+            elapsed * 1.0e9 / numSamples,
+            (double) (plugin.getNumGrainsRendered() - grainsBefore) / elapsed,
+            numSamples / configuration.sampleRate / elapsed,
+        };
+    }
+
+    Result run (const Configuration& configuration)
+    {
+        return configuration.doublePrecision ? run<double> (configuration) : run<float> (configuration);
+    }
+
+    juce::var toJSON (const Result& result)
+    {
+        auto* object = new juce::DynamicObject();
+        object->setProperty ("sampleRate", result.configuration.sampleRate);
+        object->setProperty ("blockSize", result.configuration.blockSize);
+        object->setProperty ("grainRate", result.configuration.grainRate);
+        object->setProperty ("envelopeMs", result.configuration.envelope);
+        object->setProperty ("delayTime", result.configuration.delayTime);
+        object->setProperty ("feedback", result.configuration.feedback);
+        object->setProperty ("precision", result.configuration.doublePrecision ? "double" : "float");
+        object->setProperty ("engineRate", result.configuration.reducedRate ? "reduced" : "host");
+        object->setProperty ("nsPerSample", result.nsPerSample);
+        object->setProperty ("grainsPerSecond", result.grainsPerSecond);
+        object->setProperty ("realtimeFactor", result.realtimeFactor);
+        return object;
+    }
+
+    void print (const Result& result)
+    {
+        const auto& c = result.configuration;
+        std::cout << std::fixed << std::setprecision (1)
+                  << std::setw (8) << c.sampleRate << " Hz"
+                  << std::setw (6) << c.blockSize << " smp"
+                  << std::setw (7) << c.grainRate << " grains/s"
+                  << std::setw (6) << c.envelope << " ms env"
+                  << std::setw (6) << c.delayTime << " s delay"
+                  << std::setw (6) << c.feedback << " fb"
+                  << (c.doublePrecision ? " double" : "  float")
+                  << (c.reducedRate ? " reduced | " : "    host | ")
+                  << std::setw (8) << result.nsPerSample << " ns/sample"
+                  << std::setw (10) << result.grainsPerSecond << " grains/s rendered"
+                  << std::setw (8) << result.realtimeFactor << "x realtime\n";
+    }
+}
+
+TEST_CASE ("processBlock throughput", "[throughput]")
+{
+    auto gui = juce::ScopedJuceInitialiser_GUI {};
+
+    std::vector<Configuration> configurations;
+
+    // host side: every sample rate against every block size with the default cloud
+    for (auto sampleRate : { 44100.0, 48000.0, 96000.0, 192000.0 })
+        for (auto blockSize : { 16, 64, 256, 1024, 8192 })
+            configurations.push_back ({ sampleRate, blockSize });
+
+    // engine side: the grain cloud at a typical host setting
+    for (auto grainRate : { 1.0f, 20.0f, 200.0f })
+        for (auto envelope : { 1.0f, 50.0f })
+            for (auto delayTime : { 0.01f, 1.0f })
+                for (auto feedback : { 0.0f, 0.9f })
+                    configurations.push_back ({ 48000.0, 512, grainRate, envelope, delayTime, feedback });
+
+    // precision: a sparse and a dense cloud in float and in double, side by side
+    for (auto grainRate : { 20.0f, 200.0f })
+        for (auto doublePrecision : { false, true })
+            configurations.push_back ({ 48000.0, 512, grainRate, 10.0f, 0.5f, 0.5f, doublePrecision });
+
+    // engine rate: a dense cloud at high host rates, at the host rate and at the reduced one
+    for (auto sampleRate : { 96000.0, 192000.0 })
+        for (auto reducedRate : { false, true })
+            configurations.push_back ({ sampleRate, 512, 200.0f, 10.0f, 0.5f, 0.5f, false, reducedRate });
+
+    juce::Array<juce::var> results;
+    for (const auto& configuration : configurations)
+    {
+        auto result = run (configuration);
+        print (result);
+        results.add (toJSON (result));
+        CHECK (result.realtimeFactor > 0.0);
+    }
+
+    auto* report = new juce::DynamicObject();
+    report->setProperty ("version", VERSION);
+    report->setProperty ("buildType", CMAKE_BUILD_TYPE);
+    report->setProperty ("results", results);
+
+    auto path = juce::SystemStats::getEnvironmentVariable ("LSP_BENCHMARK_JSON", "processblock_benchmarks.json");
+    auto file = juce::File::getCurrentWorkingDirectory().getChildFile (path);
+    REQUIRE (file.replaceWithText (juce::JSON::toString (juce::var (report))));
+    std::cout << "wrote " << file.getFullPathName() << "\n";
+}
+
+TEST_CASE ("processBlock trace", "[trace]")
+{
+    auto gui = juce::ScopedJuceInitialiser_GUI {};
+
+    // a dense cloud, so the trace has plenty of grains in it
+    PluginProcessor plugin;
+    setParameter (plugin, "grainRate", 200.0f);
+    setParameter (plugin, "delayTime", 0.1f);
+    setParameter (plugin, "feedback", 0.5f);
+    plugin.prepareToPlay (48000.0, 512);
+
+    juce::AudioBuffer<float> buffer (2, 512);
+    juce::MidiBuffer midi;
+    juce::Random random (42);
+    auto& trace = plugin.getTrace();
+    trace.setEnabled (true);
+    for (int block = 0; block < 200; block++)
+    {
+        for (int channel = 0; channel < buffer.getNumChannels(); channel++)
+            for (int i = 0; i < buffer.getNumSamples(); i++)
+                buffer.setSample (channel, i, random.nextFloat() * 2.0f - 1.0f);
+        plugin.processBlock (buffer, midi);
+    }
+    trace.setEnabled (false);
+    REQUIRE (trace.getNumEvents() > 0);
+
+    // the worst block, its phases are the spans right before it in the trace
+    juce::int64 slowest = 0;
+    for (int i = 0; i < trace.getNumEvents(); i++)
+        if (juce::String (trace.getEvent (i).name) == "processBlock")
+            slowest = juce::jmax (slowest, trace.getEvent (i).durationTicks);
+    std::cout << "slowest processBlock: " << juce::Time::highResolutionTicksToSeconds (slowest) * 1.0e6 << " us\n";
+
+    auto path = juce::SystemStats::getEnvironmentVariable ("LSP_TRACE_JSON", "processblock_trace.json");
+    auto file = juce::File::getCurrentWorkingDirectory().getChildFile (path);
+    REQUIRE (trace.writeChromeTrace (file, "processBlock trace"));
+    std::cout << "wrote " << file.getFullPathName() << "\n";
+}
@@ -0,0 +1,84 @@
+#include "../tests/helpers/test_helpers.h"
+#include "catch2/catch_test_macros.hpp"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+/* Scaling of the parallel grain renderer with the number of render threads.
+ *
+ * A dense cloud (200 grains/s, 50 ms envelopes, full voice count) is rendered with
+ * parallelRender on and 1, 2, 4, ... threads, up to what the shared RenderThreadPool has.
+ * The serial renderer is the baseline every speedup is reported against.
+ */
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+    constexpr double secondsToRender = 2.0;
+
+    // ns per sample, after the delay line has filled up so every voice is busy
+    double run (bool parallel, int numThreads)
+    {
+        PluginProcessor plugin;
+        setParameter (plugin, "grainRate", 200.0f);
+        setParameter (plugin, "grainAttack", 50.0f);
+        setParameter (plugin, "grainDecay", 50.0f);
+        setParameter (plugin, "grainRelease", 50.0f);
+        setParameter (plugin, "delayTime", 0.1f);
+        setParameter (plugin, "feedback", 0.9f);
+        setParameter (plugin, "maxGrains", 1024.0f);
+        setParameter (plugin, "parallelRender", parallel ? 1.0f : 0.0f);
+        plugin.setMaxRenderThreads (numThreads);
+        plugin.prepareToPlay (sampleRate, blockSize);
+
+        juce::AudioBuffer<float> input (2, blockSize);
+        juce::AudioBuffer<float> buffer (2, blockSize);
+        juce::MidiBuffer midi;
+        juce::Random random (42);
+        for (int channel = 0; channel < input.getNumChannels(); channel++)
+            for (int i = 0; i < input.getNumSamples(); i++)
+                input.setSample (channel, i, random.nextFloat() * 2.0f - 1.0f);
+
+        auto processBlocks = [&] (double seconds) {
+            auto numBlocks = (int) std::ceil (seconds * sampleRate / blockSize);
+            for (int block = 0; block < numBlocks; block++)
+            {
+                buffer.makeCopyOf (input, true);
+                plugin.processBlock (buffer, midi);
+            }
+            return numBlocks;
+        };
+
+        processBlocks (1.0);
+
+        auto start = std::chrono::steady_clock::now();
+        auto numBlocks = processBlocks (secondsToRender);
+        auto elapsed = std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+        return elapsed * 1.0e9 / ((double) numBlocks * blockSize);
+    }
+
+    void print (const char* name, double nsPerSample, double baseline)
+    {
+        std::cout << std::fixed << std::setprecision (1)
+                  << std::setw (12) << name << " | "
+                  << std::setw (8) << nsPerSample << " ns/sample"
+                  << std::setw (7) << std::setprecision (2) << baseline / nsPerSample << "x\n";
+    }
+}
+
+TEST_CASE ("Parallel render scaling", "[throughput]")
+{
+    auto gui = juce::ScopedJuceInitialiser_GUI {};
+    auto maxThreads = lsp::SharedResources::RenderThreads {}->getMaxThreads();
+
+    auto serial = run (false, 1);
+    print ("serial", serial, serial);
+
+    for (int numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+    {
+        auto parallel = run (true, numThreads);
+        auto name = juce::String (numThreads) + " threads";
+        print (name.toRawUTF8(), parallel, serial);
+        CHECK (parallel > 0.0);
+    }
+}
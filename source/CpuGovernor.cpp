@@ -0,0 +1,80 @@
+#include "CpuGovernor.h"
+
+namespace lsp {
+    void CpuGovernor::prepare(double newSampleRate) {
+        sampleRate = newSampleRate;
+        smoothedLoad = 0.0f;
+        secondsOver = 0.0;
+        secondsUnder = 0.0;
+        spawnCounter = 0;
+        load.store(0.0f, std::memory_order_relaxed);
+        setLevel(full);
+    }
+
+    void CpuGovernor::update(double renderSeconds, int numSamples) {
+        if (numSamples <= 0) {
+            return;
+        }
+        auto blockSeconds = numSamples / sampleRate;
+        auto blockLoad = (float)(renderSeconds / blockSeconds);
+        auto alpha = (float)(1.0 - std::exp(-blockSeconds / loadSmoothingTime));
+        smoothedLoad += alpha * (blockLoad - smoothedLoad);
+        load.store(smoothedLoad, std::memory_order_relaxed);
+
+        auto current = getLevel();
+        if (smoothedLoad > budget) {
+            secondsUnder = 0.0;
+            secondsOver += blockSeconds;
+            // the first step is taken right away, the next ones wait for the last one to take effect
+            if (current < quarterDensity && (current == full || secondsOver >= escalateHoldTime)) {
+                setLevel(static_cast<Level>(current + 1));
+            }
+        } else if (smoothedLoad < budget * relaxThreshold) {
+            secondsOver = 0.0;
+            secondsUnder += blockSeconds;
+            if (current > full && secondsUnder >= relaxHoldTime) {
+                setLevel(static_cast<Level>(current - 1));
+            }
+        } else {
+            // inside the hysteresis band, stay where we are
+            secondsOver = 0.0;
+            secondsUnder = 0.0;
+        }
+    }
+
+    void CpuGovernor::setLevel(Level newLevel) {
+        level.store(newLevel, std::memory_order_relaxed);
+        secondsOver = 0.0;
+        secondsUnder = 0.0;
+    }
+
+    juce::String CpuGovernor::getLevelName(Level level) {
+        switch (level) {
+            case full: return "full quality";
+            case reducedInterpolation: return "linear interpolation";
+            case noPitchShift: return "no pitch shift";
+            case halfDensity: return "half density";
+            case quarterDensity: return "quarter density";
+            case numLevels: break;
+        }
+        return {};
+    }
+
+    InterpolationType CpuGovernor::limitInterpolation(InterpolationType interpolation) const {
+        return getLevel() >= reducedInterpolation ? InterpolationType::Linear : interpolation;
+    }
+
+    float CpuGovernor::limitRate(float rate) const {
+        return getLevel() >= noPitchShift ? 1.0f : rate;
+    }
+
+    bool CpuGovernor::shouldSpawn() {
+        auto current = getLevel();
+        if (current < halfDensity) {
+            return true;
+        }
+        // keep 1 in 2 or 1 in 4 spawns
+        auto keepEvery = 1u << (current - noPitchShift);
+        return spawnCounter++ % keepEvery == 0;
+    }
+} // namespace lsp
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include "Interpolation.h"
+
+namespace lsp {
+    // Keeps the render time of processBlock under a budget (a fraction of the real-time deadline)
+    // by making newly spawned grains cheaper. Every block reports how long it took, the governor
+    // smooths that into a load and steps through the degradation levels: one step up after the
+    // load stayed over budget for a while, one step down once it has been well below it for longer.
+    // Grains that are already playing are never touched, so a level change never clicks.
+    class CpuGovernor {
+        public:
+        // each level includes the ones before it
+        enum Level {
+            full,
+            // every new grain uses linear interpolation
+            reducedInterpolation,
+            // new grains play at their original pitch, which needs no interpolation at all
+            noPitchShift,
+            // only every second spawn becomes a grain
+            halfDensity,
+            // only every fourth spawn becomes a grain
+            quarterDensity,
+            numLevels
+        };
+
+        CpuGovernor() = default;
+        ~CpuGovernor() = default;
+
+        void prepare(double sampleRate);
+        // fraction of the block duration processBlock may take, 1 is the full deadline
+        void setBudget(float newBudget) { budget = newBudget; }
+
+        // feeds the wall clock time it took to render numSamples
+        void update(double renderSeconds, int numSamples);
+
+        // these are safe to call from any thread
+        Level getLevel() const { return level.load(std::memory_order_relaxed); }
+        // smoothed render time relative to the real-time deadline
+        float getLoad() const { return load.load(std::memory_order_relaxed); }
+        static juce::String getLevelName(Level level);
+
+        // the grain parameters after degradation, called once per spawn
+        InterpolationType limitInterpolation(InterpolationType interpolation) const;
+        float limitRate(float rate) const;
+        bool shouldSpawn();
+
+        // time constant of the load smoothing
+        static constexpr double loadSmoothingTime = 0.1;
+        // how long the load has to stay over budget before the next step up
+        static constexpr double escalateHoldTime = 0.2;
+        // how long the load has to stay below relaxThreshold * budget before a step down
+        static constexpr double relaxHoldTime = 1.0;
+        static constexpr float relaxThreshold = 0.6f;
+
+        private:
+        void setLevel(Level newLevel);
+
+        double sampleRate = 44100.0;
+        float budget = 0.8f;
+        float smoothedLoad = 0.0f;
+        // seconds of audio since the load crossed into its current zone (or since the last step)
+        double secondsOver = 0.0;
+        double secondsUnder = 0.0;
+        juce::uint32 spawnCounter = 0;
+        std::atomic<Level> level { full };
+        std::atomic<float> load { 0.0f };
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CpuGovernor)
+    };
+} // namespace lsp
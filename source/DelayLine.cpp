@@ -0,0 +1,78 @@
+#include "DelayLine.h"
+
+namespace lsp {
+    void DelayLine::prepare(int newNumChannels, int minLengthInFrames, DelayPrecision newPrecision) {
+        auto newLength = juce::nextPowerOfTwo(juce::jmax(1, minLengthInFrames));
+        if (newNumChannels != numChannels || newLength != length || newPrecision != precision) {
+            numChannels = newNumChannels;
+            length = newLength;
+            precision = newPrecision;
+            auto size = (size_t)length * (size_t)numChannels;
+            // give the unused storage back, this is what the reduced precision modes are for
+            floatData.resize(precision == DelayPrecision::Float32 ? size : 0);
+            doubleData.resize(precision == DelayPrecision::Float64 ? size : 0);
+            halfData.resize(precision == DelayPrecision::Fixed16 || precision == DelayPrecision::BFloat16 ? size : 0);
+            floatData.shrink_to_fit();
+            doubleData.shrink_to_fit();
+            halfData.shrink_to_fit();
+        }
+        clear();
+    }
+
+    void DelayLine::release() {
+        std::vector<float>().swap(floatData);
+        std::vector<double>().swap(doubleData);
+        std::vector<juce::uint16>().swap(halfData);
+        numChannels = 0;
+        length = 0;
+        writePosition = 0;
+    }
+
+    void DelayLine::clear() {
+        // all zero bits are 0.0 in every storage type
+        std::fill(floatData.begin(), floatData.end(), 0.0f);
+        std::fill(doubleData.begin(), doubleData.end(), 0.0);
+        std::fill(halfData.begin(), halfData.end(), (juce::uint16)0);
+        writePosition = 0;
+    }
+
+    template <typename SampleType>
+    void DelayLine::push(const SampleType* const* channels, int startSample, int numFrames) {
+        jassert(numFrames <= length);
+        switch (precision) {
+            case DelayPrecision::Float32:
+                write<storage::Float32>(floatData.data(), channels, startSample, numFrames);
+                break;
+            case DelayPrecision::Float64:
+                write<storage::Float64>(doubleData.data(), channels, startSample, numFrames);
+                break;
+            case DelayPrecision::Fixed16:
+                write<storage::Fixed16>(reinterpret_cast<juce::int16*>(halfData.data()), channels, startSample, numFrames);
+                break;
+            case DelayPrecision::BFloat16:
+                write<storage::BFloat16>(halfData.data(), channels, startSample, numFrames);
+                break;
+        }
+        writePosition = (writePosition + numFrames) & getMask();
+    }
+
+    template <typename Storage, typename SampleType>
+    void DelayLine::write(typename Storage::Type* frames, const SampleType* const* channels, int startSample, int numFrames) {
+        for (int done = 0; done < numFrames;) {
+            // up to the end of the ring, then wrap around
+            auto position = (writePosition + done) & getMask();
+            auto num = juce::jmin(numFrames - done, length - position);
+            for (int channel = 0; channel < numChannels; channel++) {
+                const auto* source = channels[channel] + startSample + done;
+                auto* destination = frames + (size_t)position * (size_t)numChannels + (size_t)channel;
+                for (int i = 0; i < num; i++) {
+                    destination[(size_t)i * (size_t)numChannels] = Storage::encode((typename Storage::Sample)source[i]);
+                }
+            }
+            done += num;
+        }
+    }
+
+    template void DelayLine::push<float>(const float* const*, int, int);
+    template void DelayLine::push<double>(const double* const*, int, int);
+} // namespace lsp
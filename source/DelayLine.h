@@ -0,0 +1,117 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+namespace lsp {
+    // how the delay line stores its samples
+    enum class DelayPrecision {
+        Float32,
+        // 16 bit fixed point with 12 dB of headroom over full scale (feedback can push the line past 1)
+        Fixed16,
+        // the upper half of a float: float's range with 8 bits of mantissa
+        BFloat16,
+        // for hosts that process in double precision, so the feedback loop never rounds to float
+        Float64
+    };
+
+    // Conversion between samples and each storage type, the mixer's kernels are templated on these.
+    // Sample is what a stored value decodes to, the kernels do their arithmetic in it
+    namespace storage {
+        struct Float32 {
+            using Type = float;
+            using Sample = float;
+            static Type encode(float x) { return x; }
+            static float decode(Type x) { return x; }
+        };
+
+        struct Float64 {
+            using Type = double;
+            using Sample = double;
+            static Type encode(double x) { return x; }
+            static double decode(Type x) { return x; }
+        };
+
+        struct Fixed16 {
+            using Type = juce::int16;
+            using Sample = float;
+            static constexpr float headroom = 4.0f;
+            static Type encode(float x) {
+                return (Type)std::lrint(juce::jlimit(-1.0f, 1.0f, x / headroom) * 32767.0f);
+            }
+            static float decode(Type x) { return (float)x * (headroom / 32767.0f); }
+        };
+
+        struct BFloat16 {
+            using Type = juce::uint16;
+            using Sample = float;
+            static Type encode(float x) {
+                juce::uint32 bits;
+                std::memcpy(&bits, &x, sizeof(bits));
+                // round to nearest even instead of truncating
+                bits += 0x7fffu + ((bits >> 16) & 1u);
+                return (Type)(bits >> 16);
+            }
+            static float decode(Type x) {
+                auto bits = (juce::uint32)x << 16;
+                float result;
+                std::memcpy(&result, &bits, sizeof(result));
+                return result;
+            }
+        };
+    }
+
+    // Multichannel delay line with interleaved (frame packed) storage: all channels of one sample
+    // sit next to each other, so a grain reading a frame gets every channel from the same cache line.
+    // The length is a power of two and every read and write position is wrapped with a mask,
+    // so each frame is stored once and readers simply mask their (unbounded) frame index.
+    class DelayLine {
+        public:
+        DelayLine() = default;
+        ~DelayLine() = default;
+
+        // allocates numChannels x (minLengthInFrames rounded up to a power of two) and clears the
+        // history, only reallocates if the size or precision actually changed
+        void prepare(int numChannels, int minLengthInFrames, DelayPrecision precision = DelayPrecision::Float32);
+        void clear();
+        // frees the storage, prepare() has to be called before the next push
+        void release();
+
+        // appends numFrames frames, channel c is read from channels[c] + startSample,
+        // instantiated for float and double
+        template <typename SampleType>
+        void push(const SampleType* const* channels, int startSample, int numFrames);
+
+        // frame i starts at getData<S>()[(i & getMask()) * getNumChannels()],
+        // S has to be the storage type for getPrecision()
+        template <typename Storage>
+        const typename Storage::Type* getData() const {
+            return reinterpret_cast<const typename Storage::Type*>(precision == DelayPrecision::Float32 ? (const void*)floatData.data()
+                : precision == DelayPrecision::Float64 ? (const void*)doubleData.data()
+                : (const void*)halfData.data());
+        }
+        // index of the frame the next push writes
+        int getWritePosition() const { return writePosition; }
+        int getLength() const { return length; }
+        int getMask() const { return length - 1; }
+        int getNumChannels() const { return numChannels; }
+        DelayPrecision getPrecision() const { return precision; }
+        size_t getSizeInBytes() const {
+            return floatData.size() * sizeof(float) + doubleData.size() * sizeof(double) + halfData.size() * sizeof(juce::uint16);
+        }
+
+        private:
+        template <typename Storage, typename SampleType>
+        void write(typename Storage::Type* frames, const SampleType* const* channels, int startSample, int numFrames);
+
+        // only one of these is in use, depending on the precision
+        std::vector<float> floatData;
+        std::vector<double> doubleData;
+        std::vector<juce::uint16> halfData;
+        DelayPrecision precision = DelayPrecision::Float32;
+        int numChannels = 0;
+        int length = 0;
+        int writePosition = 0;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DelayLine)
+    };
+} // namespace lsp
@@ -0,0 +1,112 @@
+#include "EnvelopeCache.h"
+
+namespace lsp {
+    int EnvelopeShape::getLengthInSamples() const {
+        return (int)ceil((attack + decay + release) * sampleRate);
+    }
+
+    void EnvelopeCache::prepare(int maxLengthInSamples) {
+        maxLength = maxLengthInSamples;
+        for (auto& table : tables) {
+            // the stale contents don't matter, a table is rendered before its first user reads it
+            if (table.samples.size() != (size_t)maxLength) {
+                table.samples.assign((size_t)maxLength, 0.0f);
+            }
+            table.shape = {};
+            table.lengthInSamples = 0;
+            table.users = 0;
+            table.lastRendered = 0;
+        }
+        renderCounter = 0;
+        current = nullptr;
+    }
+
+    void EnvelopeCache::release() {
+        for (auto& table : tables) {
+            jassert(table.users == 0);
+            std::vector<float>().swap(table.samples);
+            table.shape = {};
+            table.lengthInSamples = 0;
+        }
+        maxLength = 0;
+        current = nullptr;
+    }
+
+    EnvelopeTable& EnvelopeCache::getTable(const EnvelopeShape& shape) {
+        jassert(maxLength > 0); // call prepare() first!
+
+        EnvelopeTable* unused = nullptr;
+        for (auto& table : tables) {
+            if (table.lengthInSamples > 0 && table.shape == shape)
+                return *(current = &table);
+            if (table.users == 0 && (unused == nullptr || table.lastRendered < unused->lastRendered))
+                unused = &table;
+        }
+
+        // All slots are busy when the shape changed numSlots times within one grain's lifetime,
+        // which automating the envelope does every block. Overwriting one would change the shape
+        // (and the length) under grains that are still playing, new grains get the last shape instead
+        if (unused == nullptr) {
+            jassert(current != nullptr);
+            return *current;
+        }
+
+        auto& table = *unused;
+        current = &table;
+        table.shape = shape;
+        table.lengthInSamples = juce::jmin(shape.getLengthInSamples(), maxLength);
+        table.lastRendered = ++renderCounter;
+        render(shape, table.samples.data(), table.lengthInSamples);
+        return table;
+    }
+
+    void EnvelopeCache::render(const EnvelopeShape& shape, float* destination, int lengthInSamples) {
+        if (lengthInSamples <= 0)
+            return;
+
+        auto pi = juce::MathConstants<float>::pi;
+        auto last = (float)juce::jmax(1, lengthInSamples - 1);
+
+        switch (shape.window) {
+            case WindowShape::ADSR: {
+                // run the same juce::ADSR the grains used to run themselves, note off after attack + decay
+                auto adsr = juce::ADSR();
+                adsr.setSampleRate(shape.sampleRate);
+                adsr.setParameters({ shape.attack, shape.decay, shape.sustain, shape.release });
+                auto attackPlusDecayNumSamples = (int)ceil((shape.attack + shape.decay) * shape.sampleRate);
+                adsr.noteOn();
+                for (int i = 0; i < lengthInSamples; i++) {
+                    if (i == attackPlusDecayNumSamples)
+                        adsr.noteOff();
+                    destination[i] = adsr.getNextSample();
+                }
+                break;
+            }
+            case WindowShape::Hann:
+                for (int i = 0; i < lengthInSamples; i++)
+                    destination[i] = 0.5f * (1.0f - std::cos(2.0f * pi * (float)i / last));
+                break;
+            case WindowShape::Tukey: {
+                // flat top with cosine tapers over half of the grain
+                constexpr auto alpha = 0.5f;
+                auto taper = alpha * last / 2.0f;
+                for (int i = 0; i < lengthInSamples; i++) {
+                    auto distanceToEdge = juce::jmin((float)i, last - (float)i);
+                    destination[i] = distanceToEdge < taper
+                        ? 0.5f * (1.0f - std::cos(pi * distanceToEdge / taper))
+                        : 1.0f;
+                }
+                break;
+            }
+            case WindowShape::Gaussian: {
+                constexpr auto sigma = 0.4f;
+                auto centre = last / 2.0f;
+                for (int i = 0; i < lengthInSamples; i++) {
+                    auto x = ((float)i - centre) / (sigma * centre);
+                    destination[i] = std::exp(-0.5f * x * x);
+                }
+                break;
+            }
+        }
+    }
+} // namespace lsp
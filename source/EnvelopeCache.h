@@ -0,0 +1,66 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+namespace lsp {
+    enum class WindowShape {
+        ADSR,
+        Hann,
+        Tukey,
+        Gaussian
+    };
+
+    // everything that decides what a grain's envelope looks like, times are in seconds
+    struct EnvelopeShape {
+        WindowShape window = WindowShape::ADSR;
+        float attack = 0.0f;
+        float decay = 0.0f;
+        float sustain = 1.0f;
+        float release = 0.0f;
+        double sampleRate = 44100.0;
+
+        int getLengthInSamples() const;
+        bool operator==(const EnvelopeShape&) const = default;
+    };
+
+    // one rendered envelope, shared by every grain that was spawned with the same shape
+    struct EnvelopeTable {
+        EnvelopeShape shape;
+        std::vector<float> samples;
+        int lengthInSamples = 0;
+        // number of grains currently reading from this table
+        int users = 0;
+        juce::uint64 lastRendered = 0;
+
+        const float* data() const { return samples.data(); }
+    };
+
+    // Renders each distinct grain envelope once and keeps a handful of them around, so grains
+    // that are still playing with an older shape keep a valid table after the shape changes.
+    class EnvelopeCache {
+        public:
+        static constexpr int numSlots = 8;
+
+        EnvelopeCache() = default;
+        ~EnvelopeCache() = default;
+
+        // allocates every slot for maxLengthInSamples (only if that changed), nothing allocates after this
+        void prepare(int maxLengthInSamples);
+        // frees the slots, prepare() has to be called before the next getTable()
+        void release();
+        // returns the cached table for the shape, or renders it into the least recently used free slot.
+        // A table with users is never overwritten: while every slot has some, the table returned
+        // last keeps getting handed out until one frees up
+        EnvelopeTable& getTable(const EnvelopeShape& shape);
+
+        static void render(const EnvelopeShape& shape, float* destination, int lengthInSamples);
+
+        private:
+        std::array<EnvelopeTable, numSlots> tables;
+        int maxLength = 0;
+        juce::uint64 renderCounter = 0;
+        EnvelopeTable* current = nullptr;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (EnvelopeCache)
+    };
+} // namespace lsp
@@ -1,72 +1,75 @@
 #include "Grain.h"
+#include "GrainPrerenderer.h"
 
 namespace lsp {
     Grain::Grain(
-        int sampleOffset, 
-        int delayNumSamples, 
-        juce::ADSR adsr,
-        int sampleRate,
+        juce::int64 startTime,
+        juce::int64 sourceStart,
+        EnvelopeTable& envelope,
         bool reversed,
-        bool enablePitchShift
-    ): 
-        sampleOffset(sampleOffset),
-        delayNumSamples(delayNumSamples),
-        adsr(adsr),
-        reversed(reversed),
-        sampleRate(sampleRate),
-        enablePitchShift(enablePitchShift)
+        float rate,
+        InterpolationType interpolation
+    )
     {
-        auto params = adsr.getParameters();
-        lengthInSamples = (int)ceil((params.attack + params.decay + params.decay) * sampleRate);
+        reset(startTime, sourceStart, envelope, reversed, rate, interpolation);
     }
 
-    Grain::~Grain() 
-    {
+    void Grain::reset(
+        juce::int64 newStartTime,
+        juce::int64 newSourceStart,
+        EnvelopeTable& newEnvelope,
+        bool newReversed,
+        float newRate,
+        InterpolationType newInterpolation
+    ) {
+        releaseEnvelope();
+        releasePrerender();
+        envelope = &newEnvelope;
+        envelope->users++;
+
+        startTime = newStartTime;
+        sourceStart = newSourceStart;
+        reversed = newReversed;
+        rate = newRate;
+        interpolation = newInterpolation;
+        gain = 1.0f;
+        progress = 0;
+        envelopeLevel = 0.0f;
+        lengthInSamples = envelope->lengthInSamples;
     }
 
-    void Grain::applyADSR() {
-        if (reversed) {
-            internalBuffer.reverse(0, lengthInSamples);
+    void Grain::releaseEnvelope() {
+        if (envelope != nullptr) {
+            envelope->users--;
+            envelope = nullptr;
         }
-        adsr.noteOn();
-        auto attackPlusDecay = adsr.getParameters().attack + adsr.getParameters().decay;
-        auto apdNumSamples = (int)ceil(attackPlusDecay * sampleRate);
-        adsr.applyEnvelopeToBuffer(internalBuffer, 0, apdNumSamples); 
-        adsr.noteOff();
-        adsr.applyEnvelopeToBuffer(internalBuffer, apdNumSamples, lengthInSamples - apdNumSamples);
-        if (enablePitchShift){
-            chowdsp::PitchShifter<float> pitchShifter = chowdsp::PitchShifter<float>(lengthInSamples * 2, 10);
-            pitchShifter.prepare({(double)sampleRate, (uint32_t)lengthInSamples * 2, 2});
-            pitchShifter.setShiftFactor(1.5f);
-            pitchShifter.processBlock(internalBuffer);
+    }
+
+    void Grain::releasePrerender() {
+        if (prerenderer != nullptr) {
+            prerenderer->release(prerenderSlot);
         }
+        prerendered = nullptr;
+        prerenderer = nullptr;
+        prerenderSlot = -1;
     }
 
-    void Grain::process(
-        juce::AudioBuffer<float>& buffer, 
-        float gain,
-        int startSample)
+    Grain::~Grain()
     {
-        if (progress > lengthInSamples) { // ADSR is over, so we stop
-            return;
-        }
+    }
 
-        auto numSamples = buffer.getNumSamples() - startSample;
+    int Grain::getSourceLength(int lengthInSamples, float rate) {
+        return (int)ceil(juce::jmax(0, lengthInSamples - 1) * rate) + 1 + interpolation::margin;
+    }
 
-        // cap numSamples at lengthInSamples - progress so we dont try accessing stuff beyond internalBuffer
-        if (numSamples > lengthInSamples - progress) {
-            numSamples = lengthInSamples - progress;
-        }
-        
-        for (int channel = 0; channel < buffer.getNumChannels(); channel++) {
-            buffer.addFrom(
-                channel, startSample, 
-                internalBuffer, channel, progress, 
-                numSamples, gain
-            );
-        }
-        
-        progress += numSamples;
+    int Grain::getSourceLength() const {
+        return getSourceLength(lengthInSamples, rate);
     }
 
-} // namespace lsp
\ No newline at end of file
+    int Grain::getHistoryStart(const DelayLine& delayLine, juce::int64 historyEnd) const {
+        // the newest frame in the delay line (at historyEnd - 1) sits right before the write position
+        auto framesAgo = historyEnd - (sourceStart - interpolation::margin);
+        jassert(framesAgo <= delayLine.getLength());
+        return (int)((delayLine.getWritePosition() - framesAgo) & delayLine.getMask());
+    }
+} // namespace lsp
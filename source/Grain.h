@@ -1,36 +1,70 @@
+#pragma once
+
 #include <juce_audio_basics/juce_audio_basics.h>
-#include <chowdsp_data_structures/chowdsp_data_structures.h>
-#include <chowdsp_dsp_utils/chowdsp_dsp_utils.h>
+#include "DelayLine.h"
+#include "EnvelopeCache.h"
+#include "Interpolation.h"
 
 namespace lsp {
+    class GrainPrerenderer;
+
+    // One grain voice. It reads its content straight out of the delay line history,
+    // the GrainMixer does the actual rendering
     class Grain {
         public:
+        Grain() = default;
         Grain(
-            int sampleOffset, 
-            int delayNumSamples, 
-            juce::ADSR adsr, 
-            int sampleRate, 
-            bool reversed = false, 
-            bool enablePitchShift = false
+            juce::int64 startTime,
+            juce::int64 sourceStart,
+            EnvelopeTable& envelope,
+            bool reversed = false,
+            float rate = 1.0f,
+            InterpolationType interpolation = InterpolationType::Cubic
         );
         ~Grain();
-        void process(juce::AudioBuffer<float>& buffer, float gain = 1.0f, int startSample = 0);
-        void applyADSR();
+        // reinitialises a (pooled) grain in place
+        void reset(
+            juce::int64 startTime,
+            juce::int64 sourceStart,
+            EnvelopeTable& envelope,
+            bool reversed = false,
+            float rate = 1.0f,
+            InterpolationType interpolation = InterpolationType::Cubic
+        );
+        // stops reading from the envelope table so the EnvelopeCache may reuse it
+        void releaseEnvelope();
+        // hands the prerendered slot the grain played from back to its GrainPrerenderer
+        void releasePrerender();
 
-        juce::ADSR adsr;
-        int sampleOffset;
-        int delayNumSamples;
-        int progress = 0;
-        int sampleRate;
-        bool reversed;
-        juce::AudioBuffer<float> internalBuffer;
-        bool adsrNoteOn = true;
-        bool active = true;
-        bool readyToPlay = false;
-        bool isPlaying = false;
-        bool enablePitchShift = false;
-        int lengthInSamples;
+        bool isFinished() const { return progress == lengthInSamples; }
+        // number of samples the grain reads from the delay line, including the interpolator's taps
+        int getSourceLength() const;
+        static int getSourceLength(int lengthInSamples, float rate);
+        // ring index of the first readable frame (interpolation::margin frames before sourceStart)
+        // inside the DelayLine, later frames follow it modulo the line's mask. historyEnd is the
+        // absolute time of the next frame that will be written to the delay line
+        int getHistoryStart(const DelayLine& delayLine, juce::int64 historyEnd) const;
 
-        
+        EnvelopeTable* envelope = nullptr;
+        juce::int64 startTime = 0;
+        juce::int64 sourceStart = 0;
+        int progress = 0;
+        bool reversed = false;
+        // playback speed through the source, > 1 shifts up, < 1 shifts down
+        float rate = 1.0f;
+        InterpolationType interpolation = InterpolationType::Cubic;
+        float gain = 1.0f;
+        int lengthInSamples = 0;
+        // last envelope value that was mixed, used for voice stealing
+        float envelopeLevel = 0.0f;
+        // spawn order, set by the GrainPool
+        juce::uint64 serial = 0;
+        // position inside the GrainPool's list of active grains
+        int poolIndex = -1;
+        // set while the grain plays a finished slot of a GrainPrerenderer instead of reading
+        // the delay line, the slot has the whole grain from its first sample on
+        const juce::AudioBuffer<float>* prerendered = nullptr;
+        GrainPrerenderer* prerenderer = nullptr;
+        int prerenderSlot = -1;
     };
 } // namespace lsp
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+namespace lsp {
+    // Compact picture of the playing grains, published by the audio thread for the editor.
+    // Times are in samples relative to sampleTime, so the view needs nothing else to draw it.
+    struct GrainCloud {
+        // only this many grains are drawn, the rest are counted
+        static constexpr int maxGrains = 256;
+
+        struct Grain {
+            // how long ago the grain started playing
+            int age = 0;
+            int length = 0;
+            // how far behind the delay line's write position the grain's source starts
+            int sourceDistance = 0;
+            int sourceLength = 0;
+            float rate = 1.0f;
+            // current envelope value
+            float level = 0.0f;
+            bool reversed = false;
+        };
+
+        juce::int64 sampleTime = 0;
+        double sampleRate = 44100.0;
+        // the delay line covers this many samples of history
+        int historyLength = 0;
+        int delayNumSamples = 0;
+        int numActive = 0;
+        int numGrains = 0;
+        std::array<Grain, maxGrains> grains {};
+    };
+} // namespace lsp
@@ -0,0 +1,211 @@
+#include "GrainCloudView.h"
+
+namespace
+{
+    // the pitchShift parameter's range, as octaves around the original pitch
+    constexpr float minOctave = -1.0f;
+    constexpr float maxOctave = 1.0f;
+
+    // a little history on either side of the grains that play the furthest back
+    int getWindowLength (const lsp::GrainCloud& cloud)
+    {
+        auto window = 2 * cloud.delayNumSamples + (int) (0.25 * cloud.sampleRate);
+        return juce::jmin (juce::jmax (1, window), juce::jmax (1, cloud.historyLength));
+    }
+}
+
+GrainCloudView::GrainCloudView (PluginProcessor& p)
+    : juce::ComponentMovementWatcher (this),
+      processorRef (p)
+{
+    setOpaque (true);
+}
+
+GrainCloudView::~GrainCloudView()
+{
+    setPublishing (false);
+}
+
+void GrainCloudView::setPublishing (bool shouldPublish)
+{
+    if (publishing != shouldPublish)
+    {
+        publishing = shouldPublish;
+        processorRef.setGrainCloudVisible (shouldPublish);
+    }
+}
+
+void GrainCloudView::updateRefreshing()
+{
+    if (isShowing())
+    {
+        setPublishing (true);
+        if (!isTimerRunning())
+            startTimerHz (frameRate);
+    }
+    else
+    {
+        stopTimer();
+        setPublishing (false);
+    }
+}
+
+void GrainCloudView::visibilityChanged()
+{
+    updateRefreshing();
+}
+
+void GrainCloudView::componentPeerChanged()
+{
+    updateRefreshing();
+}
+
+void GrainCloudView::componentVisibilityChanged()
+{
+    updateRefreshing();
+}
+
+void GrainCloudView::timerCallback()
+{
+    // not every platform tells us when the window gets minimised, and something else may have
+    // told the processor to stop publishing, either way there are no new frames to draw
+    if (!isShowing() || !processorRef.isGrainCloudVisible())
+    {
+        stopTimer();
+        setPublishing (false);
+        return;
+    }
+    refresh();
+}
+
+juce::RectangleList<int> GrainCloudView::refresh()
+{
+    juce::RectangleList<int> dirty;
+    auto& source = processorRef.getGrainCloud();
+    if (!source.update())
+        return dirty;
+    cloud = &source.getReadBuffer();
+
+    auto newWindowLength = getWindowLength (*cloud);
+    if (newWindowLength != windowLength || cloud->delayNumSamples != delayNumSamples)
+    {
+        // the scale changed, everything moves
+        windowLength = newWindowLength;
+        delayNumSamples = cloud->delayNumSamples;
+        background = {};
+        dirty.add (getLocalBounds());
+    }
+    else
+    {
+        dirty = drawnRegion;
+        dirty.add (getLabelBounds());
+    }
+
+    drawnRegion.clear();
+    for (int i = 0; i < cloud->numGrains; i++)
+        drawnRegion.add (getGrainBounds (cloud->grains[(size_t) i]).getSmallestIntegerContainer().expanded (1));
+    drawnRegion.clipTo (getLocalBounds());
+    drawnRegion.consolidate();
+    dirty.add (drawnRegion);
+    dirty.consolidate();
+    if (dirty.getNumRectangles() > maxDirtyRectangles)
+        dirty = juce::RectangleList<int> (dirty.getBounds());
+
+    for (const auto& area : dirty)
+        repaint (area);
+    return dirty;
+}
+
+float GrainCloudView::toX (float samplesAgo) const
+{
+    return (float) getWidth() * (1.0f - samplesAgo / (float) juce::jmax (1, windowLength));
+}
+
+float GrainCloudView::toY (float rate) const
+{
+    auto octave = juce::jlimit (minOctave, maxOctave, std::log2 (rate));
+    auto area = getLocalBounds().reduced (0, 8).toFloat();
+    return area.getBottom() - area.getHeight() * (octave - minOctave) / (maxOctave - minOctave);
+}
+
+juce::Rectangle<float> GrainCloudView::getGrainBounds (const lsp::GrainCloud::Grain& grain) const
+{
+    auto left = toX ((float) grain.sourceDistance);
+    auto right = toX ((float) (grain.sourceDistance - grain.sourceLength));
+    auto y = toY (grain.rate);
+    return { left, y - 3.0f, juce::jmax (1.0f, right - left), 6.0f };
+}
+
+juce::Rectangle<int> GrainCloudView::getLabelBounds() const
+{
+    return getLocalBounds().removeFromTop (16).removeFromLeft (160);
+}
+
+void GrainCloudView::renderBackground()
+{
+    background = juce::Image (juce::Image::RGB, juce::jmax (1, getWidth()), juce::jmax (1, getHeight()), true);
+    juce::Graphics g (background);
+    g.fillAll (juce::Colour (0xff1a1d24));
+
+    // a line per octave, and the original pitch a little brighter
+    for (auto octave : { -1.0f, 0.0f, 1.0f })
+    {
+        g.setColour (juce::Colours::white.withAlpha (octave == 0.0f ? 0.25f : 0.1f));
+        g.drawHorizontalLine (juce::roundToInt (toY (std::exp2 (octave))), 0.0f, (float) getWidth());
+    }
+
+    // a line per second of history, and where the delay time puts the grains
+    if (cloud != nullptr)
+    {
+        g.setFont (10.0f);
+        for (int second = 1; second * cloud->sampleRate < windowLength; second++)
+        {
+            auto x = toX ((float) (second * cloud->sampleRate));
+            g.setColour (juce::Colours::white.withAlpha (0.1f));
+            g.drawVerticalLine (juce::roundToInt (x), 0.0f, (float) getHeight());
+            g.setColour (juce::Colours::white.withAlpha (0.4f));
+            g.drawText ("-" + juce::String (second) + " s", juce::Rectangle<float> (x + 2.0f, (float) getHeight() - 14.0f, 40.0f, 12.0f), juce::Justification::centredLeft, false);
+        }
+        g.setColour (juce::Colours::yellow.withAlpha (0.3f));
+        g.drawVerticalLine (juce::roundToInt (toX ((float) delayNumSamples)), 0.0f, (float) getHeight());
+    }
+}
+
+void GrainCloudView::paint (juce::Graphics& g)
+{
+    if (background.getWidth() != getWidth() || background.getHeight() != getHeight())
+        renderBackground();
+    g.drawImageAt (background, 0, 0);
+    if (cloud == nullptr)
+        return;
+
+    auto clip = g.getClipBounds().toFloat();
+    for (int i = 0; i < cloud->numGrains; i++)
+    {
+        const auto& grain = cloud->grains[(size_t) i];
+        auto bounds = getGrainBounds (grain);
+        if (!bounds.intersects (clip))
+            continue;
+
+        auto colour = grain.reversed ? juce::Colours::orange : juce::Colours::skyblue;
+        g.setColour (colour.withAlpha (0.15f + 0.6f * juce::jlimit (0.0f, 1.0f, grain.level)));
+        g.fillRect (bounds);
+
+        // where in its source the grain is reading right now
+        auto played = (float) juce::jmin (grain.age, grain.length) * grain.rate;
+        auto readDistance = grain.reversed ? (float) (grain.sourceDistance - grain.sourceLength) + played : (float) grain.sourceDistance - played;
+        g.setColour (colour);
+        g.fillRect (juce::Rectangle<float> (toX (readDistance) - 0.5f, bounds.getY(), 1.5f, bounds.getHeight()));
+    }
+
+    g.setColour (juce::Colours::white.withAlpha (0.7f));
+    g.setFont (11.0f);
+    g.drawText (juce::String (cloud->numActive) + " grains", getLabelBounds().reduced (4, 0), juce::Justification::centredLeft, false);
+}
+
+void GrainCloudView::resized()
+{
+    background = {};
+    drawnRegion.clear();
+    repaint();
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "PluginProcessor.h"
+
+// Draws the playing grains over the delay line history: time runs from the oldest history on the
+// left to the write position on the right, every grain is a bar over the stretch of history it
+// reads, at the height of its pitch. The bar's brightness follows the envelope, the tick inside
+// it is the current read position and the colour tells forward from reversed grains.
+//
+// The audio thread only publishes a snapshot while this view is showing, at frameRate at most.
+// Each frame repaints the union of the rectangles the grains covered in the previous frame and
+// cover now, on top of a cached background image. The timer stops whenever the view isn't showing
+// (hidden, or its window minimised) or the processor stops publishing, and starts again once the
+// view is back on screen.
+class GrainCloudView : public juce::Component, private juce::Timer, private juce::ComponentMovementWatcher
+{
+public:
+    static constexpr int frameRate = 30;
+
+    explicit GrainCloudView (PluginProcessor&);
+    ~GrainCloudView() override;
+
+    void paint (juce::Graphics&) override;
+    void resized() override;
+    void visibilityChanged() override;
+
+    // true while the frame timer runs
+    bool isRefreshing() const { return isTimerRunning(); }
+
+    // pulls the newest snapshot and repaints what changed, returns the repainted region
+    juce::RectangleList<int> refresh();
+
+private:
+    void timerCallback() override;
+    // a parent's visibility or the window's minimised state changed
+    using juce::ComponentMovementWatcher::componentMovedOrResized;
+    using juce::ComponentMovementWatcher::componentVisibilityChanged;
+    void componentMovedOrResized (bool, bool) override {}
+    void componentPeerChanged() override;
+    void componentVisibilityChanged() override;
+    // runs the timer and publishing while the view is showing, stops both otherwise
+    void updateRefreshing();
+    void setPublishing (bool shouldPublish);
+    void renderBackground();
+    float toX (float samplesAgo) const;
+    float toY (float rate) const;
+    juce::Rectangle<float> getGrainBounds (const lsp::GrainCloud::Grain& grain) const;
+    juce::Rectangle<int> getLabelBounds() const;
+
+    // beyond this many separate rectangles one bounding box is cheaper to repaint
+    static constexpr int maxDirtyRectangles = 16;
+
+    PluginProcessor& processorRef;
+    const lsp::GrainCloud* cloud = nullptr;
+    juce::Image background;
+    // samples of history the width of the view stands for, and the delay the background shows
+    int windowLength = 0;
+    int delayNumSamples = 0;
+    // what the last frame drew grains into
+    juce::RectangleList<int> drawnRegion;
+    bool publishing = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GrainCloudView)
+};
@@ -0,0 +1,257 @@
+#include "GrainMixer.h"
+
+namespace lsp {
+    namespace {
+        // marks the rate 1 kernel, which reads the history without interpolating
+        struct Direct {};
+    }
+
+    void GrainMixer::prepare(int maxGrains, int newMaxChannels) {
+        maxChannels = newMaxChannels;
+        sources.resize((size_t)maxGrains);
+        prerendered.resize((size_t)maxGrains);
+        histories.resize((size_t)maxGrains);
+        positions.resize((size_t)maxGrains);
+        rates.resize((size_t)maxGrains);
+        envelopes.resize((size_t)maxGrains);
+        gains.resize((size_t)maxGrains);
+        remaining.resize((size_t)maxGrains);
+        accumulator.resize((size_t)(tileSize * maxChannels));
+        doubleAccumulator.resize((size_t)(tileSize * maxChannels));
+        groupStarts.fill(0);
+    }
+
+    int GrainMixer::getGroup(const Grain& grain) {
+        auto reader = direct;
+        if (grain.rate != 1.0f) {
+            switch (grain.interpolation) {
+                case InterpolationType::Linear: reader = linear; break;
+                case InterpolationType::Cubic: reader = cubic; break;
+                case InterpolationType::Lagrange: reader = lagrange; break;
+                case InterpolationType::Sinc: reader = sinc; break;
+            }
+        }
+        return reader * 2 + (grain.reversed ? 1 : 0);
+    }
+
+    void GrainMixer::gather(Grain* const* grains, int numGrains, const DelayLine& delayLine, juce::int64 historyEnd) {
+        // counting sort by group, so every kernel runs over one contiguous range
+        std::array<int, numGroups + 1> cursors {};
+        numPrerendered = 0;
+        for (int i = 0; i < numGrains; i++) {
+            if (grains[i]->isFinished()) {
+                continue;
+            }
+            if (grains[i]->prerendered != nullptr) {
+                prerendered[(size_t)numPrerendered++] = grains[i];
+            } else {
+                cursors[(size_t)getGroup(*grains[i]) + 1]++;
+            }
+        }
+        for (int group = 0; group < numGroups; group++) {
+            cursors[(size_t)group + 1] += cursors[(size_t)group];
+        }
+        groupStarts = cursors;
+
+        for (int i = 0; i < numGrains; i++) {
+            auto& grain = *grains[i];
+            if (grain.isFinished() || grain.prerendered != nullptr) {
+                continue;
+            }
+            load((size_t)cursors[(size_t)getGroup(grain)]++, grain, grain.getHistoryStart(delayLine, historyEnd));
+        }
+    }
+
+    void GrainMixer::load(size_t index, Grain& grain, int historyStart) {
+        sources[index] = &grain;
+        histories[index] = historyStart + interpolation::margin;
+        auto lastSourcePosition = (double)juce::jmax(0, grain.lengthInSamples - 1) * grain.rate;
+        auto sourcePosition = (double)grain.progress * grain.rate;
+        positions[index] = grain.reversed ? lastSourcePosition - sourcePosition : sourcePosition;
+        rates[index] = grain.rate;
+        envelopes[index] = grain.envelope->data() + grain.progress;
+        gains[index] = grain.gain;
+        remaining[index] = grain.lengthInSamples - grain.progress;
+    }
+
+    template <typename Storage, int NumChannels, bool Reversed, typename Interpolator>
+    void GrainMixer::mixGroup(int group, const DelayLine& delayLine, int numChannels, int tileStart, int tileLength) {
+        // a compile time constant in the specialised kernels
+        const auto channels = NumChannels > 0 ? NumChannels : numChannels;
+        const auto* frames = delayLine.getData<Storage>();
+        const auto mask = delayLine.getMask();
+        using Sample = typename Storage::Sample;
+        auto* sum = getAccumulator<Sample>();
+
+        for (int i = groupStarts[(size_t)group]; i < groupStarts[(size_t)group + 1]; i++) {
+            auto num = juce::jmin(tileLength, remaining[(size_t)i] - tileStart);
+            if (num <= 0) {
+                continue;
+            }
+            const auto* envelope = envelopes[(size_t)i] + tileStart;
+            auto history = histories[(size_t)i];
+            auto gain = gains[(size_t)i];
+            auto rate = Reversed ? -rates[(size_t)i] : rates[(size_t)i];
+            auto position = positions[(size_t)i] + tileStart * rate;
+
+            if constexpr (std::is_same_v<Interpolator, Direct>) {
+                auto first = history + (int)position;
+                for (int j = 0; j < num; j++) {
+                    auto weight = gain * envelope[j];
+                    const auto* frame = frames + ((first + (Reversed ? -j : j)) & mask) * channels;
+                    auto* out = sum + j * channels;
+                    for (int channel = 0; channel < channels; channel++) {
+                        out[channel] += weight * Storage::decode(frame[channel]);
+                    }
+                }
+            } else {
+                static_assert(Interpolator::before <= interpolation::margin && Interpolator::after <= interpolation::margin);
+                float coefficients[Interpolator::numTaps];
+                const typename Storage::Type* taps[Interpolator::numTaps];
+                for (int j = 0; j < num; j++) {
+                    auto p = position + j * rate;
+                    auto index = (int)p;
+                    Interpolator::getCoefficients((float)(p - index), coefficients);
+                    auto weight = gain * envelope[j];
+                    // the taps may straddle the end of the ring, so each one is wrapped on its own
+                    auto first = history + index - Interpolator::before;
+                    for (int tap = 0; tap < Interpolator::numTaps; tap++) {
+                        taps[tap] = frames + ((first + tap) & mask) * channels;
+                    }
+                    auto* out = sum + j * channels;
+                    for (int channel = 0; channel < channels; channel++) {
+                        auto value = Sample(0);
+                        for (int tap = 0; tap < Interpolator::numTaps; tap++) {
+                            value += coefficients[tap] * Storage::decode(taps[tap][channel]);
+                        }
+                        out[channel] += weight * value;
+                    }
+                }
+            }
+        }
+    }
+
+    template <typename SampleType, typename Storage, int NumChannels>
+    void GrainMixer::mix(juce::AudioBuffer<SampleType>& buffer, int startSample, int numSamples, const DelayLine& delayLine) {
+        const auto channels = NumChannels > 0 ? NumChannels : delayLine.getNumChannels();
+        auto* sum = getAccumulator<typename Storage::Sample>();
+
+        for (int tileStart = 0; tileStart < numSamples; tileStart += tileSize) {
+            auto tileLength = juce::jmin(tileSize, numSamples - tileStart);
+            juce::FloatVectorOperations::clear(sum, tileLength * channels);
+
+            mixGroup<Storage, NumChannels, false, Direct>(direct * 2, delayLine, channels, tileStart, tileLength);
+            mixGroup<Storage, NumChannels, true, Direct>(direct * 2 + 1, delayLine, channels, tileStart, tileLength);
+            mixGroup<Storage, NumChannels, false, interpolation::Linear>(linear * 2, delayLine, channels, tileStart, tileLength);
+            mixGroup<Storage, NumChannels, true, interpolation::Linear>(linear * 2 + 1, delayLine, channels, tileStart, tileLength);
+            mixGroup<Storage, NumChannels, false, interpolation::Cubic>(cubic * 2, delayLine, channels, tileStart, tileLength);
+            mixGroup<Storage, NumChannels, true, interpolation::Cubic>(cubic * 2 + 1, delayLine, channels, tileStart, tileLength);
+            mixGroup<Storage, NumChannels, false, interpolation::Lagrange>(lagrange * 2, delayLine, channels, tileStart, tileLength);
+            mixGroup<Storage, NumChannels, true, interpolation::Lagrange>(lagrange * 2 + 1, delayLine, channels, tileStart, tileLength);
+            mixGroup<Storage, NumChannels, false, interpolation::Sinc>(sinc * 2, delayLine, channels, tileStart, tileLength);
+            mixGroup<Storage, NumChannels, true, interpolation::Sinc>(sinc * 2 + 1, delayLine, channels, tileStart, tileLength);
+
+            // the only write to the output for the whole tile, back to one buffer per channel
+            for (int channel = 0; channel < channels; channel++) {
+                auto* out = buffer.getWritePointer(channel, startSample + tileStart);
+                for (int j = 0; j < tileLength; j++) {
+                    out[j] += (SampleType)sum[j * channels + channel];
+                }
+            }
+        }
+    }
+
+    template <typename SampleType, typename Storage>
+    void GrainMixer::mixChannels(juce::AudioBuffer<SampleType>& buffer, int startSample, int numSamples, const DelayLine& delayLine) {
+        switch (delayLine.getNumChannels()) {
+            case 1: mix<SampleType, Storage, 1>(buffer, startSample, numSamples, delayLine); break;
+            case 2: mix<SampleType, Storage, 2>(buffer, startSample, numSamples, delayLine); break;
+            case 4: mix<SampleType, Storage, 4>(buffer, startSample, numSamples, delayLine); break;
+            case 6: mix<SampleType, Storage, 6>(buffer, startSample, numSamples, delayLine); break;
+            case 8: mix<SampleType, Storage, 8>(buffer, startSample, numSamples, delayLine); break;
+            case 12: mix<SampleType, Storage, 12>(buffer, startSample, numSamples, delayLine); break;
+            case 16: mix<SampleType, Storage, 16>(buffer, startSample, numSamples, delayLine); break;
+            default: mix<SampleType, Storage, 0>(buffer, startSample, numSamples, delayLine); break;
+        }
+    }
+
+    template <typename SampleType>
+    void GrainMixer::process(
+        Grain* const* grains,
+        int numGrains,
+        juce::AudioBuffer<SampleType>& buffer,
+        int startSample,
+        int numSamples,
+        const DelayLine& delayLine,
+        juce::int64 historyEnd)
+    {
+        jassert(numGrains <= (int)sources.size()); // call prepare() first!
+        if (numSamples <= 0) {
+            return;
+        }
+
+        gather(grains, numGrains, delayLine, historyEnd);
+        addPrerendered(buffer, startSample, numSamples);
+        auto numActive = groupStarts.back();
+        if (numActive == 0) {
+            return;
+        }
+
+        mixStorage(buffer, startSample, numSamples, delayLine);
+        for (int i = 0; i < numActive; i++) {
+            auto& grain = *sources[(size_t)i];
+            grain.progress += juce::jmin(numSamples, remaining[(size_t)i]);
+            grain.envelopeLevel = grain.envelope->data()[grain.progress - 1];
+        }
+    }
+
+    void GrainMixer::render(Grain& grain, int historyStart, juce::AudioBuffer<float>& buffer, const DelayLine& delayLine) {
+        jassert(!sources.empty()); // call prepare() first!
+        auto numSamples = grain.lengthInSamples - grain.progress;
+        jassert(numSamples <= buffer.getNumSamples());
+        buffer.clear(0, numSamples);
+        if (numSamples <= 0) {
+            return;
+        }
+
+        // a group of one
+        auto group = getGroup(grain);
+        for (int g = 0; g <= numGroups; g++) {
+            groupStarts[(size_t)g] = g > group ? 1 : 0;
+        }
+        load(0, grain, historyStart);
+        mixStorage(buffer, 0, numSamples, delayLine);
+    }
+
+    template <typename SampleType>
+    void GrainMixer::mixStorage(juce::AudioBuffer<SampleType>& buffer, int startSample, int numSamples, const DelayLine& delayLine) {
+        // the delay line is frame packed, so every channel it has is read even if the buffer has fewer
+        jassert(delayLine.getNumChannels() <= maxChannels && delayLine.getNumChannels() <= buffer.getNumChannels());
+        switch (delayLine.getPrecision()) {
+            case DelayPrecision::Float32: mixChannels<SampleType, storage::Float32>(buffer, startSample, numSamples, delayLine); break;
+            case DelayPrecision::Float64: mixChannels<SampleType, storage::Float64>(buffer, startSample, numSamples, delayLine); break;
+            case DelayPrecision::Fixed16: mixChannels<SampleType, storage::Fixed16>(buffer, startSample, numSamples, delayLine); break;
+            case DelayPrecision::BFloat16: mixChannels<SampleType, storage::BFloat16>(buffer, startSample, numSamples, delayLine); break;
+        }
+    }
+
+    template <typename SampleType>
+    void GrainMixer::addPrerendered(juce::AudioBuffer<SampleType>& buffer, int startSample, int numSamples) {
+        for (int i = 0; i < numPrerendered; i++) {
+            auto& grain = *prerendered[(size_t)i];
+            auto num = juce::jmin(numSamples, grain.lengthInSamples - grain.progress);
+            for (int channel = 0; channel < grain.prerendered->getNumChannels(); channel++) {
+                const auto* source = grain.prerendered->getReadPointer(channel, grain.progress);
+                auto* out = buffer.getWritePointer(channel, startSample);
+                for (int j = 0; j < num; j++) {
+                    out[j] += (SampleType)source[j];
+                }
+            }
+            grain.progress += num;
+            grain.envelopeLevel = grain.envelope->data()[grain.progress - 1];
+        }
+    }
+
+    template void GrainMixer::process<float>(Grain* const*, int, juce::AudioBuffer<float>&, int, int, const DelayLine&, juce::int64);
+    template void GrainMixer::process<double>(Grain* const*, int, juce::AudioBuffer<double>&, int, int, const DelayLine&, juce::int64);
+} // namespace lsp
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "Grain.h"
+
+namespace lsp {
+    // Mixes a set of grains into a buffer with one fused kernel.
+    // The hot state of the grains (read positions, rates, envelope positions, gains) is gathered
+    // into structure of arrays storage, sorted by the reader each grain needs and its direction.
+    // The output is then rendered in tiles of tileSize samples: every grain adds into a frame packed
+    // accumulator that stays in L1 and the target buffer is only touched once per tile, instead
+    // of once per grain. Reads come from the interleaved DelayLine, so the interpolator's weights
+    // are computed once per frame and the channel loop vectorises. The kernels are specialised at
+    // compile time for the delay line's storage type, the common channel counts, the direction and
+    // the interpolator, so the per sample loop has no branches. They add up in the precision the
+    // storage decodes to, so a double delay line mixes in double all the way to the output.
+    // Grains that play a prerendered slot (see GrainPrerenderer) are simply added from it.
+    class GrainMixer {
+        public:
+        static constexpr int tileSize = 64;
+
+        GrainMixer() = default;
+        ~GrainMixer() = default;
+
+        // allocates room for maxGrains grains and maxChannels channels
+        void prepare(int maxGrains, int maxChannels);
+
+        // mixes the next numSamples of every grain into buffer (from startSample on) and advances them,
+        // historyEnd is the absolute time of the next frame that will be written to the delay line.
+        // Instantiated for float and double buffers
+        template <typename SampleType>
+        void process(
+            Grain* const* grains,
+            int numGrains,
+            juce::AudioBuffer<SampleType>& buffer,
+            int startSample,
+            int numSamples,
+            const DelayLine& delayLine,
+            juce::int64 historyEnd
+        );
+        // renders a whole grain, from its current progress to its end, into the start of buffer
+        // without advancing it. historyStart is the grain's getHistoryStart() at the time the
+        // caller read the delay line's write position, so this may run on another thread
+        void render(Grain& grain, int historyStart, juce::AudioBuffer<float>& buffer, const DelayLine& delayLine);
+
+        private:
+        // rate 1 grains are copied sample by sample, everything else goes through its interpolator
+        enum Reader { direct, linear, cubic, lagrange, sinc, numReaders };
+        static constexpr int numGroups = numReaders * 2;
+        static int getGroup(const Grain& grain);
+
+        template <typename SampleType, typename Storage>
+        void mixChannels(juce::AudioBuffer<SampleType>& buffer, int startSample, int numSamples, const DelayLine& delayLine);
+        // NumChannels 0 is the generic kernel, for channel counts that don't have their own
+        template <typename SampleType, typename Storage, int NumChannels>
+        void mix(juce::AudioBuffer<SampleType>& buffer, int startSample, int numSamples, const DelayLine& delayLine);
+        template <typename Storage, int NumChannels, bool Reversed, typename Interpolator>
+        void mixGroup(int group, const DelayLine& delayLine, int numChannels, int tileStart, int tileLength);
+
+        void gather(Grain* const* grains, int numGrains, const DelayLine& delayLine, juce::int64 historyEnd);
+        // puts the grain's hot state at index
+        void load(size_t index, Grain& grain, int historyStart);
+        template <typename SampleType>
+        void addPrerendered(juce::AudioBuffer<SampleType>& buffer, int startSample, int numSamples);
+        template <typename SampleType>
+        void mixStorage(juce::AudioBuffer<SampleType>& buffer, int startSample, int numSamples, const DelayLine& delayLine);
+        // the accumulator for the precision a storage type decodes to
+        template <typename Sample>
+        Sample* getAccumulator() {
+            if constexpr (std::is_same_v<Sample, double>) {
+                return doubleAccumulator.data();
+            } else {
+                return accumulator.data();
+            }
+        }
+
+        // grains of each group are contiguous in the arrays below, from groupStarts[g] to groupStarts[g + 1]
+        std::array<int, numGroups + 1> groupStarts {};
+        std::vector<Grain*> sources;
+        // the grains that play a prerendered slot
+        std::vector<Grain*> prerendered;
+        int numPrerendered = 0;
+        // unwrapped ring index of the first frame the grain reads (interpolation::margin frames into its history)
+        std::vector<int> histories;
+        // source position (relative to the history index) at the grain's current progress
+        std::vector<double> positions;
+        std::vector<double> rates;
+        // envelope table at the grain's current progress
+        std::vector<const float*> envelopes;
+        std::vector<float> gains;
+        // samples the grain has left to play
+        std::vector<int> remaining;
+        // tileSize frames of maxChannels channels
+        std::vector<float> accumulator;
+        std::vector<double> doubleAccumulator;
+        int maxChannels = 0;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GrainMixer)
+    };
+} // namespace lsp
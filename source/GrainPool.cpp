@@ -0,0 +1,105 @@
+#include "GrainPool.h"
+
+namespace lsp {
+    void GrainPool::prepare(int capacity) {
+        activeGrains.clear();
+        freeGrains.clear();
+        if ((int)grains.size() != capacity) {
+            grains = std::vector<Grain>((size_t)capacity);
+        }
+        activeGrains.reserve((size_t)capacity);
+        freeGrains.reserve((size_t)capacity);
+
+        // push in reverse so grains get handed out front to back
+        for (auto it = grains.rbegin(); it != grains.rend(); it++) {
+            it->poolIndex = -1;
+            // the EnvelopeCache and the GrainPrerenderer get re-prepared alongside the pool,
+            // don't touch the old tables and slots
+            it->envelope = nullptr;
+            it->prerendered = nullptr;
+            it->prerenderer = nullptr;
+            it->prerenderSlot = -1;
+            freeGrains.push_back(&*it);
+        }
+        nextSerial = 0;
+        numStolen = 0;
+        numShed = 0;
+    }
+
+    void GrainPool::clear() {
+        while (!activeGrains.empty()) {
+            release(*activeGrains.back());
+        }
+    }
+
+    Grain& GrainPool::acquire(int maxActiveGrains, StealingPolicy policy) {
+        jassert(!grains.empty()); // call prepare() first!
+        maxActiveGrains = juce::jlimit(1, getCapacity(), maxActiveGrains);
+
+        // the voice limit may have been lowered since the last block
+        for (int shed = 0; shed < maxShedPerAcquire && getNumActive() > maxActiveGrains; shed++) {
+            release(steal(policy));
+            numShed++;
+        }
+
+        Grain* grain;
+        // still above the limit, the new grain replaces one instead of adding to them
+        if (getNumActive() >= maxActiveGrains) {
+            // the stolen grain stays in activeGrains and simply gets reused
+            grain = &steal(policy);
+            numStolen++;
+        } else {
+            grain = freeGrains.back();
+            freeGrains.pop_back();
+            grain->poolIndex = (int)activeGrains.size();
+            activeGrains.push_back(grain);
+        }
+        grain->serial = nextSerial++;
+        return *grain;
+    }
+
+    void GrainPool::release(Grain& grain) {
+        jassert(grain.poolIndex >= 0 && activeGrains[(size_t)grain.poolIndex] == &grain);
+
+        // swap with the last active grain so the removal is O(1)
+        auto* last = activeGrains.back();
+        activeGrains[(size_t)grain.poolIndex] = last;
+        last->poolIndex = grain.poolIndex;
+        activeGrains.pop_back();
+
+        grain.poolIndex = -1;
+        grain.releaseEnvelope();
+        grain.releasePrerender();
+        freeGrains.push_back(&grain);
+    }
+
+    void GrainPool::releaseFinished() {
+        // walk backwards so the swap in release() only moves grains we've already checked
+        for (auto i = getNumActive() - 1; i >= 0; i--) {
+            auto* grain = activeGrains[(size_t)i];
+            if (grain->isFinished()) {
+                release(*grain);
+            }
+        }
+    }
+
+    Grain& GrainPool::steal(StealingPolicy policy) {
+        jassert(!activeGrains.empty());
+        // a grain spawned earlier in the same block hasn't played a sample yet, it ranks above every
+        // grain that has instead of looking silent
+        auto getLevel = [](const Grain* grain) {
+            return grain->progress == 0 ? std::numeric_limits<float>::max() : grain->envelopeLevel;
+        };
+        // ties are broken by age, so the choice is deterministic either way
+        auto* victim = activeGrains.front();
+        for (auto* grain : activeGrains) {
+            if (policy == StealingPolicy::Quietest && getLevel(grain) != getLevel(victim)) {
+                if (getLevel(grain) < getLevel(victim))
+                    victim = grain;
+            } else if (grain->serial < victim->serial) {
+                victim = grain;
+            }
+        }
+        return *victim;
+    }
+} // namespace lsp
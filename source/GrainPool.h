@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Grain.h"
+
+namespace lsp {
+    // which grain gets replaced when a new one is spawned while the pool is full
+    enum class StealingPolicy {
+        Oldest,
+        // the grain with the lowest last mixed envelope level. Grains that haven't been mixed yet
+        // only go once there's nothing else, their level of 0 says nothing about how loud they'll be
+        Quietest
+    };
+
+    // Fixed capacity storage for grains. All memory is allocated in prepare(), acquiring and
+    // releasing a grain afterwards is O(1) and never touches the heap.
+    class GrainPool {
+        public:
+        GrainPool() = default;
+        ~GrainPool() = default;
+
+        // allocates capacity grains
+        void prepare(int capacity);
+        // drops all active grains
+        void clear();
+
+        // returns a grain from the free list, or steals one if maxActiveGrains are already in use.
+        // If the limit was lowered, at most maxShedPerAcquire of the grains above it are released
+        // first, the rest go with the next spawns or when they finish
+        Grain& acquire(int maxActiveGrains, StealingPolicy policy);
+        void release(Grain& grain);
+        // releases every grain that has finished playing
+        void releaseFinished();
+
+        const std::vector<Grain*>& getActiveGrains() const { return activeGrains; }
+        int getNumActive() const { return (int)activeGrains.size(); }
+        int getCapacity() const { return (int)grains.size(); }
+        juce::uint64 getNumStolen() const { return numStolen; }
+        // grains released because the voice limit was lowered, not counted as stolen
+        juce::uint64 getNumShed() const { return numShed; }
+
+        // every shed grain costs a steal() scan, this keeps a big drop in the limit from
+        // turning one spawn into thousands of them
+        static constexpr int maxShedPerAcquire = 4;
+
+        private:
+        Grain& steal(StealingPolicy policy);
+
+        std::vector<Grain> grains;
+        std::vector<Grain*> freeGrains;
+        std::vector<Grain*> activeGrains;
+        juce::uint64 nextSerial = 0;
+        juce::uint64 numStolen = 0;
+        juce::uint64 numShed = 0;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GrainPool)
+    };
+} // namespace lsp
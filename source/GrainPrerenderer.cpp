@@ -0,0 +1,221 @@
+#include "GrainPrerenderer.h"
+
+namespace lsp {
+    PrerenderThread::PrerenderThread() : juce::Thread("lsp prerender") {
+        // whatever the audio threads leave over, a missed grain only costs the time it would have anyway
+        startThread(juce::Thread::Priority::low);
+    }
+
+    PrerenderThread::~PrerenderThread() {
+        signalThreadShouldExit();
+        notify();
+        stopThread(1000);
+    }
+
+    void PrerenderThread::add(GrainPrerenderer& prerenderer) {
+        const juce::ScopedLock lock(clientsLock);
+        clients.addIfNotAlreadyThere(&prerenderer);
+    }
+
+    void PrerenderThread::remove(GrainPrerenderer& prerenderer) {
+        // the worker holds the lock while it renders, so this waits for the current grain
+        const juce::ScopedLock lock(clientsLock);
+        clients.removeFirstMatchingValue(&prerenderer);
+    }
+
+    void PrerenderThread::notify() {
+        wakeups.fetch_add(1, std::memory_order_release);
+        wakeups.notify_one();
+    }
+
+    void PrerenderThread::run() {
+        while (!threadShouldExit()) {
+            auto seen = wakeups.load(std::memory_order_acquire);
+            auto rendered = false;
+            {
+                const juce::ScopedLock lock(clientsLock);
+                // one grain per instance in turn, so a busy instance doesn't hold up the others
+                for (auto* client : clients) {
+                    rendered = client->renderNext(mixer) || rendered;
+                }
+            }
+            if (!rendered) {
+                wakeups.wait(seen, std::memory_order_acquire);
+            }
+        }
+    }
+
+    GrainPrerenderer::~GrainPrerenderer() {
+        release();
+    }
+
+    void GrainPrerenderer::prepare(int newNumChannels, int maxLength, const DelayLine& newDelayLine) {
+        stop();
+        maxLength = juce::jmax(1, maxLength);
+        if (slots.empty() || newNumChannels != numChannels || maxLength != slots.front()->output.getNumSamples()) {
+            numChannels = newNumChannels;
+            slots.clear();
+            slots.reserve(numSlots);
+            freeSlots.reserve(numSlots);
+            retiringSlots.reserve(numSlots);
+            for (int i = 0; i < numSlots; i++) {
+                slots.push_back(std::make_unique<Slot>());
+                slots.back()->output.setSize(numChannels, maxLength);
+            }
+        }
+        freeSlots.clear();
+        for (int i = numSlots - 1; i >= 0; i--) {
+            freeSlots.push_back(i);
+        }
+        delayLine = &newDelayLine;
+        blockEnd.store(0, std::memory_order_relaxed);
+        running = true;
+        thread->add(*this);
+    }
+
+    void GrainPrerenderer::stop() {
+        if (!running) {
+            return;
+        }
+        thread->remove(*this);
+        running = false;
+        // the worker is gone, so every slot is ours again
+        for (int i = 0; i < (int)slots.size(); i++) {
+            if (slots[(size_t)i]->inUse) {
+                reclaim(i);
+            }
+        }
+        retiringSlots.clear();
+        queue.reset();
+    }
+
+    void GrainPrerenderer::release() {
+        stop();
+        std::vector<std::unique_ptr<Slot>>().swap(slots);
+        std::vector<int>().swap(freeSlots);
+        std::vector<int>().swap(retiringSlots);
+        delayLine = nullptr;
+    }
+
+    void GrainPrerenderer::update(juce::int64 newBlockEnd) {
+        blockEnd.store(newBlockEnd, std::memory_order_relaxed);
+        for (auto i = (int)retiringSlots.size() - 1; i >= 0; i--) {
+            auto slot = retiringSlots[(size_t)i];
+            if (slots[(size_t)slot]->state.load(std::memory_order_acquire) == retired) {
+                retiringSlots[(size_t)i] = retiringSlots.back();
+                retiringSlots.pop_back();
+                reclaim(slot);
+            }
+        }
+    }
+
+    int GrainPrerenderer::acquire() {
+        if (freeSlots.empty()) {
+            return -1;
+        }
+        auto slot = freeSlots.back();
+        freeSlots.pop_back();
+        slots[(size_t)slot]->inUse = true;
+        return slot;
+    }
+
+    void GrainPrerenderer::submit(int index, const GrainEvent& event, juce::int64 historyEnd) {
+        auto& slot = *slots[(size_t)index];
+        jassert(slot.inUse && slot.state.load(std::memory_order_relaxed) == idle);
+        slot.grain.reset(event.startTime, event.sourceStart, *event.envelope, event.reversed, event.rate, event.interpolation);
+        slot.historyStart = slot.grain.getHistoryStart(*delayLine, historyEnd);
+        slot.deadline = event.startTime;
+        // publishes the grain above along with the state
+        slot.state.store(queued, std::memory_order_release);
+
+        // there are as many places in the queue as slots, this can't fail
+        const auto scope = queue.write(1);
+        jassert(scope.blockSize1 + scope.blockSize2 == 1);
+        queuedSlots[(size_t)(scope.blockSize1 > 0 ? scope.startIndex1 : scope.startIndex2)] = index;
+        thread->notify();
+    }
+
+    bool GrainPrerenderer::attach(Grain& grain, int index) {
+        auto& slot = *slots[(size_t)index];
+        if (slot.state.load(std::memory_order_acquire) != done) {
+            cancel(index);
+            return false;
+        }
+        grain.prerendered = &slot.output;
+        grain.prerenderer = this;
+        grain.prerenderSlot = index;
+        return true;
+    }
+
+    void GrainPrerenderer::release(int index) {
+        jassert(slots[(size_t)index]->state.load(std::memory_order_relaxed) == idle
+            || slots[(size_t)index]->state.load(std::memory_order_relaxed) == done);
+        reclaim(index);
+    }
+
+    void GrainPrerenderer::cancelAll() {
+        for (int i = 0; i < (int)slots.size(); i++) {
+            if (slots[(size_t)i]->inUse) {
+                cancel(i);
+            }
+        }
+    }
+
+    void GrainPrerenderer::cancel(int index) {
+        auto& slot = *slots[(size_t)index];
+        if (slot.retiring) {
+            return;
+        }
+        auto state = slot.state.load(std::memory_order_acquire);
+        while (state == queued || state == rendering) {
+            // the worker still has it, it lets go of the slot by marking it retired
+            if (slot.state.compare_exchange_weak(state, cancelled, std::memory_order_acq_rel)) {
+                slot.retiring = true;
+                retiringSlots.push_back(index);
+                return;
+            }
+        }
+        reclaim(index);
+    }
+
+    void GrainPrerenderer::reclaim(int index) {
+        auto& slot = *slots[(size_t)index];
+        slot.state.store(idle, std::memory_order_relaxed);
+        slot.grain.releaseEnvelope();
+        slot.inUse = false;
+        slot.retiring = false;
+        freeSlots.push_back(index);
+    }
+
+    bool GrainPrerenderer::renderNext(GrainMixer& mixer) {
+        int index;
+        {
+            const auto scope = queue.read(1);
+            if (scope.blockSize1 + scope.blockSize2 == 0) {
+                return false;
+            }
+            index = queuedSlots[(size_t)(scope.blockSize1 > 0 ? scope.startIndex1 : scope.startIndex2)];
+        }
+
+        auto& slot = *slots[(size_t)index];
+        auto expected = (int)queued;
+        // a grain that already started is of no use, the audio thread renders it itself
+        if (slot.deadline < blockEnd.load(std::memory_order_relaxed)
+            || !slot.state.compare_exchange_strong(expected, rendering, std::memory_order_acq_rel)) {
+            slot.state.store(retired, std::memory_order_release);
+            return true;
+        }
+
+        // The grain's source was complete when it was queued, and the delay line only overwrites
+        // it a whole ring later, long after the grain has played. A worker that falls that far
+        // behind has been cancelled, and what it renders is thrown away
+        mixer.prepare(1, numChannels);
+        mixer.render(slot.grain, slot.historyStart, slot.output, *delayLine);
+
+        expected = rendering;
+        if (!slot.state.compare_exchange_strong(expected, done, std::memory_order_acq_rel)) {
+            slot.state.store(retired, std::memory_order_release);
+        }
+        return true;
+    }
+} // namespace lsp
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "GrainMixer.h"
+#include "GrainScheduler.h"
+#include <atomic>
+
+namespace lsp {
+    class GrainPrerenderer;
+
+    // One low priority thread, shared by all plugin instances, that renders the grains their
+    // GrainPrerenderers queued. It takes one grain from every instance in turn and sleeps
+    // (on an atomic, so waking it never locks) once all queues are empty.
+    class PrerenderThread : private juce::Thread {
+        public:
+        PrerenderThread();
+        ~PrerenderThread() override;
+
+        // message thread only, remove() waits until the thread is done with the prerenderer
+        void add(GrainPrerenderer& prerenderer);
+        void remove(GrainPrerenderer& prerenderer);
+
+        // audio thread, after queueing a grain
+        void notify();
+
+        private:
+        void run() override;
+
+        juce::CriticalSection clientsLock;
+        juce::Array<GrainPrerenderer*> clients;
+        std::atomic<juce::uint32> wakeups { 0 };
+        GrainMixer mixer;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PrerenderThread)
+    };
+
+    // Renders grains ahead of time on the PrerenderThread.
+    // A grain's source is complete long before it plays whenever the delay is longer than the
+    // grain, so the audio thread queues such grains right when they're spawned and the worker has
+    // until the grain's start time to render it (envelope, pitch and all) into one of a fixed set
+    // of slots. When the grain starts, the audio thread plays the slot if it's done and otherwise
+    // gives up on it and mixes the grain itself, like every grain that didn't get a slot.
+    // Slots change hands through one atomic state each, and go to the worker through a single
+    // producer, single consumer FIFO, so the audio thread never waits for the worker.
+    class GrainPrerenderer {
+        public:
+        // grains that can be waiting for or playing from a slot at the same time
+        static constexpr int numSlots = 32;
+
+        GrainPrerenderer() = default;
+        ~GrainPrerenderer();
+
+        // allocates the slots (unless they already have this size) and starts taking grains,
+        // maxLength is the longest grain in samples. The delay line has to outlive the
+        // prerenderer or the next stop() / release()
+        void prepare(int numChannels, int maxLength, const DelayLine& delayLine);
+        // stops taking grains and gives up every slot, call this before the delay line changes.
+        // Waits for the grain the worker is rendering, if it has one of ours
+        void stop();
+        // stops and frees the slots
+        void release();
+        bool isPrepared() const { return running; }
+
+        // Audio thread only from here on.
+        // Every block, before any grain is spawned or started, with the end of the block's time
+        // span: grains that start before that aren't worth rendering any more
+        void update(juce::int64 blockEnd);
+        // a free slot for the grain about to be scheduled, or -1
+        int acquire();
+        // hands the scheduled grain to the worker, historyEnd is the absolute time the delay
+        // line's write position stands for
+        void submit(int slot, const GrainEvent& event, juce::int64 historyEnd);
+        // lets the grain play the slot if it's been rendered, otherwise gives the slot up,
+        // returns false if the grain has to be mixed by the audio thread
+        bool attach(Grain& grain, int slot);
+        // gives back a slot that was acquired but never submitted, or one a grain played from
+        void release(int slot);
+        // gives up on every slot, for when the scheduled grains get dropped
+        void cancelAll();
+
+        int getNumFree() const { return (int)freeSlots.size(); }
+
+        private:
+        friend class PrerenderThread;
+        // renders the next queued grain on the worker, returns false if there was none
+        bool renderNext(GrainMixer& mixer);
+        void cancel(int slot);
+        void reclaim(int slot);
+
+        enum State { idle, queued, rendering, done, cancelled, retired };
+
+        struct Slot {
+            std::atomic<int> state { idle };
+            // a copy of the grain, it holds its own user of the envelope table
+            Grain grain;
+            int historyStart = 0;
+            juce::int64 deadline = 0;
+            juce::AudioBuffer<float> output;
+            // audio thread bookkeeping
+            bool inUse = false;
+            bool retiring = false;
+        };
+
+        std::vector<std::unique_ptr<Slot>> slots;
+        std::vector<int> freeSlots;
+        // slots that were given up while the worker had them, until it lets go
+        std::vector<int> retiringSlots;
+        // an AbstractFifo holds one item less than its size
+        juce::AbstractFifo queue { numSlots + 1 };
+        std::array<int, numSlots + 1> queuedSlots {};
+        std::atomic<juce::int64> blockEnd { 0 };
+        const DelayLine* delayLine = nullptr;
+        int numChannels = 0;
+        bool running = false;
+        juce::SharedResourcePointer<PrerenderThread> thread;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GrainPrerenderer)
+    };
+} // namespace lsp
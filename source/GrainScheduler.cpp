@@ -0,0 +1,58 @@
+#include "GrainScheduler.h"
+
+namespace lsp {
+    void GrainScheduler::prepare(int newCapacity) {
+        capacity = newCapacity;
+        events.clear();
+        events.reserve((size_t)capacity);
+        nextOrder = 0;
+    }
+
+    void GrainScheduler::clear() {
+        for (auto& event : events) {
+            event.envelope->users--;
+        }
+        events.clear();
+    }
+
+    bool GrainScheduler::schedule(GrainEvent event) {
+        if (getNumPending() >= capacity) {
+            return false;
+        }
+        event.order = nextOrder++;
+        event.envelope->users++;
+        // stays within the reserved capacity, so this never allocates
+        events.push_back(event);
+        std::push_heap(events.begin(), events.end(), isLater);
+        return true;
+    }
+
+    juce::int64 GrainScheduler::getNextEventTime() const {
+        return events.empty() ? std::numeric_limits<juce::int64>::max() : events.front().startTime;
+    }
+
+    juce::int64 GrainScheduler::getEarliestSourceStart() const {
+        // the heap is ordered by start time, not by source
+        auto earliest = std::numeric_limits<juce::int64>::max();
+        for (const auto& event : events) {
+            earliest = juce::jmin(earliest, event.sourceStart);
+        }
+        return earliest;
+    }
+
+    GrainEvent GrainScheduler::pop() {
+        jassert(!events.empty());
+        std::pop_heap(events.begin(), events.end(), isLater);
+        auto event = events.back();
+        events.pop_back();
+        event.envelope->users--;
+        return event;
+    }
+
+    bool GrainScheduler::isLater(const GrainEvent& a, const GrainEvent& b) {
+        // std heaps keep the largest element in front, so "larger" means later here
+        if (a.startTime != b.startTime)
+            return a.startTime > b.startTime;
+        return a.order > b.order;
+    }
+} // namespace lsp
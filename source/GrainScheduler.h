@@ -0,0 +1,58 @@
+#pragma once
+
+#include "EnvelopeCache.h"
+#include "Interpolation.h"
+
+namespace lsp {
+    // a spawned grain waiting for its start time, it only gets a voice from the GrainPool once it starts
+    struct GrainEvent {
+        // absolute sample the grain starts playing at
+        juce::int64 startTime = 0;
+        // absolute sample of the delay line history the grain starts reading at
+        juce::int64 sourceStart = 0;
+        // the event holds one user of this table until the grain has started
+        EnvelopeTable* envelope = nullptr;
+        bool reversed = false;
+        float rate = 1.0f;
+        InterpolationType interpolation = InterpolationType::Cubic;
+        // spawn order, keeps events with the same start time first in first out
+        juce::uint64 order = 0;
+        // GrainPrerenderer slot the grain is being rendered into ahead of time, or -1
+        int prerenderSlot = -1;
+    };
+
+    // Time ordered queue of grain start events (a binary min heap on preallocated storage).
+    // processBlock splits each block at the times this hands out, so grains start sample accurately
+    // and the per block work only depends on the grains that are due or playing.
+    class GrainScheduler {
+        public:
+        GrainScheduler() = default;
+        ~GrainScheduler() = default;
+
+        // allocates room for capacity pending grains
+        void prepare(int capacity);
+        // drops all pending grains
+        void clear();
+
+        // returns false (and drops the grain) if the queue is full
+        bool schedule(GrainEvent event);
+        // start time of the earliest event, or the largest int64 if nothing is pending
+        juce::int64 getNextEventTime() const;
+        // removes and returns the earliest event, only call this if there is one
+        GrainEvent pop();
+
+        int getNumPending() const { return (int)events.size(); }
+        // the earliest sourceStart of the pending grains, or the largest int64 if nothing is pending
+        juce::int64 getEarliestSourceStart() const;
+        int getCapacity() const { return capacity; }
+
+        private:
+        static bool isLater(const GrainEvent& a, const GrainEvent& b);
+
+        std::vector<GrainEvent> events;
+        int capacity = 0;
+        juce::uint64 nextOrder = 0;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GrainScheduler)
+    };
+} // namespace lsp
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace lsp {
+    enum class InterpolationType {
+        Linear,
+        Cubic,
+        Lagrange,
+        Sinc
+    };
+
+    // Fractional delay line interpolators. Each one weights a fixed number of contiguous taps
+    // around x[0] (from x[-before] to x[after]). getCoefficients() gives the numTaps weights for a
+    // fractional position, so multichannel readers like the GrainMixer compute them once per frame
+    // and apply them to every channel as a fixed length dot product.
+    namespace interpolation {
+        // the most any kernel reads before or after the current sample
+        constexpr int margin = 4;
+
+        struct Linear {
+            static constexpr int before = 0;
+            static constexpr int after = 1;
+            static constexpr int numTaps = before + after + 1;
+
+            static void getCoefficients(float frac, float* coefficients) {
+                coefficients[0] = 1.0f - frac;
+                coefficients[1] = frac;
+            }
+        };
+
+        // 4 point Catmull-Rom spline
+        struct Cubic {
+            static constexpr int before = 1;
+            static constexpr int after = 2;
+            static constexpr int numTaps = before + after + 1;
+
+            // the spline polynomial in frac, collected by tap instead of by power
+            static void getCoefficients(float frac, float* coefficients) {
+                auto t = frac;
+                auto t2 = t * t;
+                auto t3 = t2 * t;
+                coefficients[0] = -0.5f * t3 + t2 - 0.5f * t;
+                coefficients[1] = 1.5f * t3 - 2.5f * t2 + 1.0f;
+                coefficients[2] = -1.5f * t3 + 2.0f * t2 + 0.5f * t;
+                coefficients[3] = 0.5f * t3 - 0.5f * t2;
+            }
+        };
+
+        // 4 point, 3rd order Lagrange polynomial
+        struct Lagrange {
+            static constexpr int before = 1;
+            static constexpr int after = 2;
+            static constexpr int numTaps = before + after + 1;
+
+            static void getCoefficients(float frac, float* coefficients) {
+                auto d = frac;
+                coefficients[0] = -d * (d - 1.0f) * (d - 2.0f) / 6.0f;
+                coefficients[1] = (d + 1.0f) * (d - 1.0f) * (d - 2.0f) / 2.0f;
+                coefficients[2] = -(d + 1.0f) * d * (d - 2.0f) / 2.0f;
+                coefficients[3] = (d + 1.0f) * d * (d - 1.0f) / 6.0f;
+            }
+        };
+
+        // 8 tap Blackman windowed sinc, the taps for each fractional position are
+        // precomputed in a polyphase table and picked by linearly blending two phases
+        struct Sinc {
+            static constexpr int numTaps = 8;
+            static constexpr int numPhases = 256;
+            static constexpr int before = numTaps / 2 - 1;
+            static constexpr int after = numTaps / 2;
+
+            using Table = std::array<std::array<float, numTaps>, numPhases + 1>;
+
+            static const Table& getTable() {
+                static const Table table = [] {
+                    Table t {};
+                    constexpr auto pi = 3.14159265358979323846;
+                    for (int phase = 0; phase <= numPhases; phase++) {
+                        auto frac = (double)phase / numPhases;
+                        for (int tap = 0; tap < numTaps; tap++) {
+                            auto x = (double)(tap - before) - frac;
+                            auto sinc = x == 0.0 ? 1.0 : std::sin(pi * x) / (pi * x);
+                            auto n = (x + numTaps / 2.0) / numTaps; // 0..1 across the window
+                            auto window = 0.42 - 0.5 * std::cos(2.0 * pi * n) + 0.08 * std::cos(4.0 * pi * n);
+                            t[(size_t)phase][(size_t)tap] = (float)(sinc * window);
+                        }
+                    }
+                    return t;
+                }();
+                return table;
+            }
+
+            static void getCoefficients(float frac, float* coefficients) {
+                const auto& table = getTable();
+                auto phase = frac * numPhases;
+                auto index = (int)phase;
+                auto blend = phase - (float)index;
+                const auto& lower = table[(size_t)index];
+                const auto& upper = table[(size_t)std::min(index + 1, numPhases)];
+                for (int i = 0; i < numTaps; i++)
+                    coefficients[i] = lower[(size_t)i] + blend * (upper[(size_t)i] - lower[(size_t)i]);
+            }
+        };
+    } // namespace interpolation
+} // namespace lsp
@@ -6,6 +6,7 @@ PluginEditor::PluginEditor (PluginProcessor& p)
     juce::ignoreUnused (processorRef);
 
     addAndMakeVisible (inspectButton);
+    addAndMakeVisible (grainCloudView);
 
     // this chunk of code instantiates and opens the melatonin inspector
     inspectButton.onClick = [&] {
@@ -20,7 +21,8 @@ PluginEditor::PluginEditor (PluginProcessor& p)
 
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
-    setSize (400, 300);
+    setSize (500, 420);
+    startTimerHz (30);
 }
 
 PluginEditor::~PluginEditor()
@@ -32,17 +34,61 @@ void PluginEditor::paint (juce::Graphics& g)
     // (Our component is opaque, so we must completely fill the background with a solid colour)
     g.fillAll (getLookAndFeel().findColour (juce::ResizableWindow::backgroundColourId));
 
-    auto area = getLocalBounds();
     g.setColour (juce::Colours::white);
     g.setFont (16.0f);
     auto helloWorld = juce::String ("Hello from ") + PRODUCT_NAME_WITHOUT_VERSION + " v" VERSION + " running in " + CMAKE_BUILD_TYPE;
-    g.drawText (helloWorld, area.removeFromTop (150), juce::Justification::centred, false);
+    g.drawText (helloWorld, getLocalBounds().reduced (10).removeFromTop (30), juce::Justification::centred, false);
+
+    const auto& governor = processorRef.getCpuGovernor();
+    auto area = meterArea;
+    drawMeter (g, area.removeFromTop (rowHeight), "CPU", juce::String (juce::roundToInt (telemetry.averageLoad * 100.0f)) + "% (peak " + juce::String (juce::roundToInt (telemetry.peakLoad * 100.0f)) + "%)", telemetry.averageLoad, telemetry.peakLoad);
+    drawMeter (g, area.removeFromTop (rowHeight), "Grains", juce::String (telemetry.activeGrains) + " / " + juce::String (telemetry.maxGrains), (float) telemetry.activeGrains / (float) juce::jmax (1, telemetry.maxGrains), 0.0f);
+    drawMeter (g, area.removeFromTop (rowHeight), "Feedback", juce::String (juce::Decibels::gainToDecibels (telemetry.feedbackLevel), 1) + " dB", juce::jmin (1.0f, telemetry.feedbackLevel), 0.0f);
+
+    g.setColour (juce::Colours::white);
+    g.setFont (12.0f);
+    auto counters = juce::String ("spawned ") + juce::String (telemetry.totalSpawned)
+        + ", stolen " + juce::String (telemetry.totalStolen)
+        + ", culled " + juce::String (telemetry.totalCulled)
+        + ", prerendered " + juce::String (telemetry.totalPrerendered) + " (missed " + juce::String (telemetry.totalPrerenderMisses) + ")"
+        + ", " + (telemetry.sleeping ? juce::String ("asleep") : lsp::CpuGovernor::getLevelName (governor.getLevel()));
+    g.drawText (counters, area.removeFromTop (rowHeight), juce::Justification::centredLeft, false);
+}
+
+void PluginEditor::drawMeter (juce::Graphics& g, juce::Rectangle<int> area, const juce::String& label, const juce::String& text, float value, float peak)
+{
+    g.setColour (juce::Colours::white);
+    g.setFont (12.0f);
+    g.drawText (label, area.removeFromLeft (70), juce::Justification::centredLeft, false);
+    g.drawText (text, area.removeFromRight (110), juce::Justification::centredRight, false);
+
+    auto bar = area.reduced (0, 5).toFloat();
+    g.setColour (juce::Colours::white.withAlpha (0.15f));
+    g.fillRect (bar);
+    g.setColour (value > 0.9f ? juce::Colours::orangered : juce::Colours::limegreen);
+    g.fillRect (bar.withWidth (bar.getWidth() * juce::jlimit (0.0f, 1.0f, value)));
+    if (peak > 0.0f)
+    {
+        g.setColour (juce::Colours::white);
+        g.fillRect (bar.getX() + bar.getWidth() * juce::jlimit (0.0f, 1.0f, peak) - 1.0f, bar.getY(), 2.0f, bar.getHeight());
+    }
+}
+
+void PluginEditor::timerCallback()
+{
+    if (!isShowing())
+        return;
+    telemetry = processorRef.getTelemetry().getSnapshot();
+    // the grain cloud repaints itself, only the meters change here
+    repaint (meterArea);
 }
 
 void PluginEditor::resized()
 {
     // layout the positions of your child components here
-    auto area = getLocalBounds();
-    area.removeFromBottom(50);
-    inspectButton.setBounds (getLocalBounds().withSizeKeepingCentre(100, 50));
+    auto area = getLocalBounds().reduced (10);
+    area.removeFromTop (30);
+    inspectButton.setBounds (area.removeFromBottom (40).withSizeKeepingCentre (100, 30));
+    meterArea = area.removeFromBottom (4 * rowHeight);
+    grainCloudView.setBounds (area.reduced (0, 4));
 }
@@ -1,11 +1,12 @@
 #pragma once
 
 #include "PluginProcessor.h"
+#include "GrainCloudView.h"
 #include "BinaryData.h"
 #include "melatonin_inspector/melatonin_inspector.h"
 
 //==============================================================================
-class PluginEditor : public juce::AudioProcessorEditor
+class PluginEditor : public juce::AudioProcessorEditor, private juce::Timer
 {
 public:
     explicit PluginEditor (PluginProcessor&);
@@ -15,11 +16,22 @@ public:
     void paint (juce::Graphics&) override;
     void resized() override;
 
+    GrainCloudView& getGrainCloudView() { return grainCloudView; }
+
 private:
+    // pulls the latest telemetry and repaints the meters
+    void timerCallback() override;
+    // one labelled horizontal bar, value and peak are 0..1
+    static void drawMeter (juce::Graphics& g, juce::Rectangle<int> area, const juce::String& label, const juce::String& text, float value, float peak);
+
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
     PluginProcessor& processorRef;
     std::unique_ptr<melatonin::Inspector> inspector;
     juce::TextButton inspectButton { "Inspect the UI" };
+    GrainCloudView grainCloudView { processorRef };
+    lsp::Telemetry::Snapshot telemetry;
+    static constexpr int rowHeight = 22;
+    juce::Rectangle<int> meterArea;
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PluginEditor)
 };
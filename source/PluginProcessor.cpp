@@ -1,6 +1,6 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
-#include "SharedResources.h"
+#include "RealtimeCheck.h"
 
 //==============================================================================
 PluginProcessor::PluginProcessor()
@@ -13,6 +13,28 @@ PluginProcessor::PluginProcessor()
                      #endif
                        ), apvts(*this, nullptr, "CoolAudioProcessorValueTreeType", getParameterLayout())
 {
+    // look everything up once, the audio thread only ever does atomic loads on these
+    rawParameters.grainRate = apvts.getRawParameterValue("grainRate");
+    rawParameters.grainAttack = apvts.getRawParameterValue("grainAttack");
+    rawParameters.grainDecay = apvts.getRawParameterValue("grainDecay");
+    rawParameters.grainSustain = apvts.getRawParameterValue("grainSustain");
+    rawParameters.grainRelease = apvts.getRawParameterValue("grainRelease");
+    rawParameters.grainWindow = apvts.getRawParameterValue("grainWindow");
+    rawParameters.pitchShift = apvts.getRawParameterValue("pitchShift");
+    rawParameters.interpolation = apvts.getRawParameterValue("interpolation");
+    rawParameters.delayTime = apvts.getRawParameterValue("delayTime");
+    rawParameters.delayTimeVar = apvts.getRawParameterValue("delayTimeVar");
+    rawParameters.feedback = apvts.getRawParameterValue("feedback");
+    rawParameters.dryMix = apvts.getRawParameterValue("dryMix");
+    rawParameters.wetMix = apvts.getRawParameterValue("wetMix");
+    rawParameters.maxGrains = apvts.getRawParameterValue("maxGrains");
+    rawParameters.grainStealing = apvts.getRawParameterValue("grainStealing");
+    rawParameters.parallelRender = apvts.getRawParameterValue("parallelRender");
+    rawParameters.backgroundRender = apvts.getRawParameterValue("backgroundRender");
+    rawParameters.cpuBudget = apvts.getRawParameterValue("cpuBudget");
+    rawParameters.seed = apvts.getRawParameterValue("seed");
+    rawParameters.delayPrecision = apvts.getRawParameterValue("delayPrecision");
+    rawParameters.engineRate = apvts.getRawParameterValue("engineRate");
 }
 
 PluginProcessor::~PluginProcessor()
@@ -54,7 +76,23 @@ bool PluginProcessor::isMidiEffect() const
 
 double PluginProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    // Every pass through the delay line takes two delay times (the content goes in one delay
+    // before a grain spawns and plays one delay after) plus a grain, and comes back quieter by the
+    // feedback gain. The tail ends once the passes have brought it below tailThreshold, and comes
+    // out of a reduced rate engine later by the converter's latency
+    auto delayTime = (double) rawParameters.delayTime->load (std::memory_order_relaxed);
+    auto feedbackGain = (double) rawParameters.feedback->load (std::memory_order_relaxed);
+    auto grainLength = (rawParameters.grainAttack->load (std::memory_order_relaxed)
+        + rawParameters.grainDecay->load (std::memory_order_relaxed)
+        + rawParameters.grainRelease->load (std::memory_order_relaxed)) / 1000.0;
+    auto passLength = 2.0 * delayTime + grainLength;
+
+    auto numPasses = 1.0;
+    if (feedbackGain > 0.0)
+        numPasses += std::ceil (std::log (tailThreshold) / std::log (feedbackGain));
+    // the latency is in host samples, and the host rate is only known once prepared
+    auto latency = preparedLayout.has_value() ? getLatencySamples() / preparedLayout->hostSampleRate : 0.0;
+    return juce::jmin (maxTailSeconds, numPasses * passLength + latency);
 }
 
 int PluginProcessor::getNumPrograms()
@@ -89,15 +127,143 @@ void PluginProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
+    clearGrains();
+    // the background renderer reads the delay line, it has to let go before that's cleared or reallocated
+    prerenderer.stop();
+    // Hosts prepare every instance when a session loads and again whenever the device changes,
+    // mostly with the settings the instance already has. Those only reset the state below
+    auto layout = getEngineLayout(sampleRate, samplesPerBlock);
+    if (layout != preparedLayout) {
+        allocate(layout);
+        preparedLayout = layout;
+    } else {
+        delayLine.clear();
+        rateConverter.reset();
+    }
+    // the converter's filters delay everything by the same amount, hosts compensate for it
+    setLatencySamples(rateConverter.getLatencyInSamples());
+    // from here on everything runs at the engine rate
+    sampleRate = layout.sampleRate;
+    engineSampleRate = sampleRate;
+    grainEnvelope = nullptr;
     updateParameters(sampleRate);
-    updateDelayBufferSizes(sampleRate);
-    juce::ignoreUnused (samplesPerBlock);
+    // start the ramps at the current values instead of fading in from whatever was there before
+    for (auto* smoother : { &delayTimeSmoother, &feedbackSmoother, &dryMixSmoother, &wetMixSmoother }) {
+        smoother->reset(sampleRate, parameterSmoothingTime);
+        smoother->setCurrentAndTargetValue(smoother->getTargetValue());
+    }
+    // grains stream through the delay line at least two minimum delay times behind the input,
+    // segments must be shorter than that (minus the interpolators' look ahead)
+    auto minDelayNumSamples = (int)ceil(apvts.getParameterRange("delayTime").getRange().getStart() * sampleRate);
+    maxSegmentLength = juce::jmax(1, 2 * minDelayNumSamples - lsp::interpolation::margin);
+    sampleClock = 0;
+    nextSpawnTime = 0;
+    cpuGovernor.prepare(sampleRate);
+    telemetry.reset();
+    samplesUntilGrainCloud = 0;
+    sleeping = false;
+    silentSamples = 0;
+    randomBatchSize = layout.randomBatchSize;
+    reseed();
+    if (!layout.doublePrecision) {
+        prerenderer.prepare(layout.numChannels, layout.maxGrainLength, delayLine);
+    }
+}
+
+PluginProcessor::EngineLayout PluginProcessor::getEngineLayout(double hostSampleRate, int hostBlockSize) {
+    EngineLayout layout;
+    layout.hostSampleRate = hostSampleRate;
+    layout.hostBlockSize = hostBlockSize;
+    // An integer factor keeps the converter a plain polyphase filter, 96 and 192 kHz run the
+    // engine at 48 kHz, 88.2 and 176.4 kHz at 44.1 kHz
+    if (rawParameters.engineRate->load(std::memory_order_relaxed) >= 0.5f) {
+        layout.engineRateFactor = juce::jlimit(1, maxEngineRateFactor, (int)(hostSampleRate / reducedEngineRate));
+    }
+    layout.sampleRate = hostSampleRate / layout.engineRateFactor;
+    // the decimator hands the engine at most this many samples per host block
+    layout.blockSize = layout.engineRateFactor == 1 ? hostBlockSize : hostBlockSize / layout.engineRateFactor + 1;
+    auto sampleRate = layout.sampleRate;
+    auto samplesPerBlock = layout.blockSize;
+    layout.numInputChannels = getTotalNumInputChannels();
+    layout.doublePrecision = isUsingDoublePrecision();
+
+    // Grains read their content straight from the delay line while they play. A grain looks back
+    // furthest right before it ends: its own length, plus either twice its delay (the content went in
+    // one delay before the spawn and plays one delay after it) or, for reversed and sped up grains,
+    // its whole source, plus the taps the interpolators read around it. delayTimeVar only spreads
+    // the spawn times out, it never moves a grain's source further back
+    auto maxDelayNumSamples = (int)ceil(apvts.getParameterRange("delayTime").getRange().getEnd() * sampleRate);
+    layout.maxGrainLength = (int)ceil(getMaxGrainLength() * sampleRate);
+    auto maxSourceLength = lsp::Grain::getSourceLength(layout.maxGrainLength, apvts.getParameterRange("pitchShift").getRange().getEnd());
+    layout.maxHistoryLength = layout.maxGrainLength + juce::jmax(2 * maxDelayNumSamples, maxSourceLength) + lsp::interpolation::margin;
+    // one frame packed line for all channels of whatever layout the host picked
+    layout.numChannels = juce::jmax(1, layout.numInputChannels);
+    layout.delayPrecision = static_cast<lsp::DelayPrecision>((int)rawParameters.delayPrecision->load(std::memory_order_relaxed));
+    // full precision follows the host, so the feedback loop of a double host never rounds to float
+    if (layout.delayPrecision == lsp::DelayPrecision::Float32 && layout.doublePrecision) {
+        layout.delayPrecision = lsp::DelayPrecision::Float64;
+    }
+
+    // the pool is sized for the highest voice count the maxGrains parameter allows,
+    // so turning it up while playing never allocates
+    layout.grainPoolCapacity = (int)apvts.getParameterRange("maxGrains").getRange().getEnd();
+    // every grain spawned within one delay time can be waiting to start
+    auto maxPendingGrains = apvts.getParameterRange("grainRate").getRange().getEnd()
+        * apvts.getParameterRange("delayTime").getRange().getEnd();
+    layout.schedulerCapacity = (int)ceil(maxPendingGrains) + 64;
+    // enough values for every spawn in a block at the highest grain rate
+    auto minGrainPeriod = (int)ceil(sampleRate / apvts.getParameterRange("grainRate").getRange().getEnd());
+    layout.randomBatchSize = juce::jmax(256, 2 * (samplesPerBlock / minGrainPeriod + 1));
+    // one partial buffer and mixer per render task, enough for a full pool
+    layout.maxRenderTasks = (layout.grainPoolCapacity + grainsPerRenderTask - 1) / grainsPerRenderTask;
+    return layout;
+}
+
+void PluginProcessor::allocate(const EngineLayout& layout) {
+    // every prepare below only reallocates what actually changed size, so switching
+    // the sample rate or the block size keeps most of the memory
+    envelopeCache.prepare(layout.maxGrainLength);
+    delayLine.prepare(layout.numChannels, layout.maxHistoryLength, layout.delayPrecision);
+    grainPool.prepare(layout.grainPoolCapacity);
+    grainScheduler.prepare(layout.schedulerCapacity);
+    random.prepare(layout.randomBatchSize);
+    grainMixer.prepare(layout.grainPoolCapacity, layout.numChannels);
+    while (renderMixers.size() < layout.maxRenderTasks) {
+        renderMixers.add(new lsp::GrainMixer());
+    }
+    for (int task = 0; task < layout.maxRenderTasks; task++) {
+        renderMixers[task]->prepare(grainsPerRenderTask, layout.numChannels);
+    }
+    rateConverter.prepare(layout.numInputChannels, layout.engineRateFactor, layout.hostBlockSize);
+    // the host picks the precision before preparing, the other set of buffers isn't needed
+    auto reducedRate = layout.engineRateFactor > 1;
+    if (layout.doublePrecision) {
+        doubleBuffers.prepare(layout.numInputChannels, layout.blockSize, layout.maxRenderTasks, reducedRate);
+        floatBuffers = {};
+        prerenderer.release();
+    } else {
+        floatBuffers.prepare(layout.numInputChannels, layout.blockSize, layout.maxRenderTasks, reducedRate);
+        doubleBuffers = {};
+    }
+    // builds the static polyphase table now instead of on the audio thread
+    lsp::interpolation::Sinc::getTable();
 }
 
 void PluginProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+    // The large allocations (delay line, envelope tables, prerender slots and block buffers)
+    // go, the next prepareToPlay allocates them again
+    clearGrains();
+    prerenderer.release();
+    grainEnvelope = nullptr;
+    envelopeCache.release();
+    delayLine.release();
+    rateConverter.release();
+    floatBuffers = {};
+    doubleBuffers = {};
+    preparedLayout.reset();
 }
 
 bool PluginProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
@@ -106,10 +272,10 @@ bool PluginProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
     juce::ignoreUnused (layouts);
     return true;
   #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Any layout works (mono, stereo, surround, ambisonics...), the delay line
+    // and the grain mixer handle every channel the same way
+    auto numChannels = layouts.getMainOutputChannelSet().size();
+    if (numChannels < 1 || numChannels > maxChannels)
         return false;
 
     // This checks if the input layout matches the output layout
@@ -131,61 +297,139 @@ juce::AudioProcessorValueTreeState::ParameterLayout PluginProcessor::getParamete
         std::make_unique<juce::AudioParameterFloat>("grainDecay", "grainDecay", 1.0f, 50.0f, 10.0f),
         std::make_unique<juce::AudioParameterFloat>("grainSustain", "grainSustain", 0.0f, 1.0f, 1.0f),
         std::make_unique<juce::AudioParameterFloat>("grainRelease", "grainRelease", 1.0f, 50.0f, 20.0f),
+        std::make_unique<juce::AudioParameterChoice>("grainWindow", "Grain Window", juce::StringArray { "ADSR", "Hann", "Tukey", "Gaussian" }, 0),
+        std::make_unique<juce::AudioParameterFloat>("pitchShift", "Pitch Shift", 0.5f, 2.0f, 1.5f),
+        std::make_unique<juce::AudioParameterChoice>("interpolation", "Interpolation", juce::StringArray { "Linear", "Cubic", "Lagrange", "Sinc" }, 1),
         std::make_unique<juce::AudioParameterFloat>("delayTime", "Delay Time", 0.01f, 4.0f, 1.0f),
         std::make_unique<juce::AudioParameterFloat>("delayTimeVar", "delayTimeVar", 0.0f, 0.5f, 0.1f),
         std::make_unique<juce::AudioParameterFloat>("feedback", "Feedback", 0.0f, 0.99f, 0.2f),
         std::make_unique<juce::AudioParameterFloat>("dryMix", "Dry Mix", 0.0f, 1.0f, 0.8f),
         std::make_unique<juce::AudioParameterFloat>("wetMix", "Wet Mix", 0.0f, 1.0f, 0.6f),
-        std::make_unique<juce::AudioParameterBool>("DEBUG", "DEBUG", false),
+        std::make_unique<juce::AudioParameterInt>("maxGrains", "Max Grains", 16, 1024, 512),
+        std::make_unique<juce::AudioParameterChoice>("grainStealing", "Grain Stealing", juce::StringArray { "Oldest", "Quietest" }, 0),
+        std::make_unique<juce::AudioParameterBool>("parallelRender", "Parallel Render", false),
+        // renders grains on a low priority thread between their spawn and start, smoothing out
+        // blocks where many grains play at once
+        std::make_unique<juce::AudioParameterBool>("backgroundRender", "Background Render", true),
+        std::make_unique<juce::AudioParameterFloat>("cpuBudget", "CPU Budget", 10.0f, 100.0f, 80.0f),
+        // 0 picks a new seed every time playback is prepared, anything else renders the same grains every time
+        std::make_unique<juce::AudioParameterInt>("seed", "Random Seed", 0, 99999, 0),
+        // 16 bit storage halves the delay line's memory, which adds up with many instances.
+        // Full precision is float, or double if the host processes in double.
+        // It reallocates, so it only takes effect the next time playback is prepared
+        std::make_unique<juce::AudioParameterChoice>("delayPrecision", "Delay Precision", juce::StringArray { "Full Precision", "16 Bit Fixed", "BFloat16" }, 0,
+            juce::AudioParameterChoiceAttributes().withAutomatable(false)),
+        // Runs the grains, the delay line and the feedback at 44.1 or 48 kHz when the host runs at
+        // a multiple of that, dry signal included, which cuts their cost and the delay line's memory
+        // by the same factor. The resampling filters add latency. Like the delay precision it
+        // only takes effect the next time playback is prepared
+        std::make_unique<juce::AudioParameterChoice>("engineRate", "Engine Rate", juce::StringArray { "Host Rate", "Reduced" }, 0,
+            juce::AudioParameterChoiceAttributes().withAutomatable(false)),
     };
 }
 
 template <typename T>
-void PluginProcessor::updateParameter(T& paramRef, const char* parameterName) {
-    paramRef = apvts.getRawParameterValue(parameterName)->load();
+void PluginProcessor::updateParameter(T& paramRef, const std::atomic<float>* parameter) {
+    paramRef = static_cast<T>(parameter->load(std::memory_order_relaxed));
 }
 
 
-void PluginProcessor::updateParameters(int sampleRate) {
-    updateParameter(grainAttack, "grainAttack");
+void PluginProcessor::updateParameters(double sampleRate) {
+    // everything is read once per block, so the whole block sees one consistent snapshot
+    updateParameter(grainAttack, rawParameters.grainAttack);
     grainAttack /= 1000.0f;
-    updateParameter(grainDecay, "grainDecay");
+    updateParameter(grainDecay, rawParameters.grainDecay);
     grainDecay /= 1000.0f;
-    updateParameter(grainSustain, "grainSustain");
-    updateParameter(grainRelease, "grainRelease");
+    updateParameter(grainSustain, rawParameters.grainSustain);
+    updateParameter(grainRelease, rawParameters.grainRelease);
     grainRelease /= 1000.0f;
-    updateParameter(grainRate, "grainRate");
-    // grainRate = static_cast<juce::AudioParameterFloat*>(apvts.getParameter("grainRate"))->get();
+    grainWindow = static_cast<lsp::WindowShape>((int)rawParameters.grainWindow->load(std::memory_order_relaxed));
+
+    // all grains spawned with the same shape share one envelope table,
+    // a new one only gets rendered when the shape actually changed and a slot is free, while the
+    // envelope is automated with long grains playing, new grains keep the last one that fit
+    lsp::EnvelopeShape grainShape { grainWindow, grainAttack, grainDecay, grainSustain, grainRelease, sampleRate };
+    if (grainEnvelope == nullptr || grainEnvelope->shape != grainShape) {
+        grainEnvelope = &envelopeCache.getTable(grainShape);
+    }
+
+    updateParameter(grainRate, rawParameters.grainRate);
     grainPeriod = (int)ceil(sampleRate / grainRate);
 
-    updateParameter(delayTimeVar, "delayTimeVar");
-    delayTime = apvts.getParameterAsValue("delayTime").getValue();;
-    feedback = apvts.getParameterAsValue("feedback").getValue();
-    dryMix = apvts.getParameterAsValue("dryMix").getValue();
-    wetMix = apvts.getParameterAsValue("wetMix").getValue();
-    // wow! what an intuitive way to get my boolean parameter!
-    auto debugFlagParam = dynamic_cast<juce::AudioParameterBool*>(apvts.getParameter("DEBUG"));
-    if (debugFlagParam != nullptr) {
-        debugFlag = debugFlagParam->get();
+    updateParameter(pitchShift, rawParameters.pitchShift);
+    interpolation = static_cast<lsp::InterpolationType>((int)rawParameters.interpolation->load(std::memory_order_relaxed));
+
+    updateParameter(maxGrains, rawParameters.maxGrains);
+    grainStealing = static_cast<lsp::StealingPolicy>((int)rawParameters.grainStealing->load(std::memory_order_relaxed));
+    parallelRender = rawParameters.parallelRender->load(std::memory_order_relaxed) >= 0.5f;
+    backgroundRender = rawParameters.backgroundRender->load(std::memory_order_relaxed) >= 0.5f;
+    // in percent of the block duration
+    cpuGovernor.setBudget(rawParameters.cpuBudget->load(std::memory_order_relaxed) / 100.0f);
+
+    auto newSeed = (int)rawParameters.seed->load(std::memory_order_relaxed);
+    if (newSeed != seed) {
+        seed = newSeed;
+        reseed();
+    }
+
+    updateParameter(delayTimeVar, rawParameters.delayTimeVar);
+    // the continuous ones are ramped towards their new value sample by sample
+    updateParameter(delayTime, rawParameters.delayTime);
+    delayTimeSmoother.setTargetValue(delayTime);
+    updateParameter(feedback, rawParameters.feedback);
+    feedbackSmoother.setTargetValue(feedback);
+    updateParameter(dryMix, rawParameters.dryMix);
+    dryMixSmoother.setTargetValue(dryMix);
+    updateParameter(wetMix, rawParameters.wetMix);
+    wetMixSmoother.setTargetValue(wetMix);
+}
+
+void PluginProcessor::reseed() {
+    if (seed != 0) {
+        random.seed((juce::uint64)seed);
+    } else {
+        random.seed((juce::uint64)juce::Time::getHighResolutionTicks() ^ (juce::uint64)(juce::pointer_sized_uint)this);
     }
-    
 }
 
-void PluginProcessor::updateDelayBufferSizes(int sampleRate) {
-    auto minDelayBufferSize = (int)ceil(2 * sampleRate * apvts.getParameterRange("delayTime").getRange().getEnd());
-    auto channelSet = getBusesLayout().getMainOutputChannelSet();
-    uint numChannels = 1;
-    // if stereo, make sure to make 2 delay buffers
-    // also if more channels are supported in the future, the code below should stay valid
-    if (channelSet == juce::AudioChannelSet::stereo()) {
-        numChannels = 2;
+template <typename SampleType>
+void PluginProcessor::fillParameterRamp(juce::SmoothedValue<float>& smoother, juce::AudioBuffer<SampleType>& ramps, int ramp, int numSamples) {
+    auto* values = ramps.getWritePointer(ramp);
+    if (!smoother.isSmoothing()) {
+        juce::FloatVectorOperations::fill(values, (SampleType)smoother.getTargetValue(), numSamples);
+        return;
+    }
+    for (int i = 0; i < numSamples; i++) {
+        values[i] = smoother.getNextValue();
     }
-    while (delayBuffers.size() < numChannels) {
-        delayBuffers.push_back(chowdsp::DoubleBuffer<float>(512));
+}
+
+float PluginProcessor::getMaxGrainLength() {
+    // same formula as lsp::EnvelopeShape uses for the grain length, in seconds
+    return (apvts.getParameterRange("grainAttack").getRange().getEnd()
+        + apvts.getParameterRange("grainDecay").getRange().getEnd()
+        + apvts.getParameterRange("grainRelease").getRange().getEnd()) / 1000.0f;
+}
+
+template <typename SampleType>
+void PluginProcessor::BlockBuffers<SampleType>::prepare(int numChannels, int numSamples, int numRenderTasks, bool reducedRate) {
+    // a smaller block size keeps the memory that's already there
+    parameterRamps.setSize(numParameterRamps, numSamples, false, false, true);
+    wet.setSize(numChannels, numSamples, false, false, true);
+    dry.setSize(numChannels, numSamples, false, false, true);
+    renderPartials.resize((size_t)numRenderTasks);
+    for (auto& partial : renderPartials) {
+        partial.setSize(numChannels, numSamples, false, false, true);
     }
-    for (int i = 0; i < numChannels; i++) {
-        if (delayBuffers[i].size() < minDelayBufferSize)
-            delayBuffers[i].resize(minDelayBufferSize);
+    engine.setSize(numChannels, reducedRate ? numSamples : 0, false, false, true);
+}
+
+template <typename SampleType>
+PluginProcessor::BlockBuffers<SampleType>& PluginProcessor::getBuffers() {
+    if constexpr (std::is_same_v<SampleType, double>) {
+        return doubleBuffers;
+    } else {
+        return floatBuffers;
     }
 }
 
@@ -193,11 +437,28 @@ void PluginProcessor::processBlock (juce::AudioBuffer<float>& buffer,
                                               juce::MidiBuffer& midiMessages)
 {
     juce::ignoreUnused (midiMessages);
+    process (buffer);
+}
+
+void PluginProcessor::processBlock (juce::AudioBuffer<double>& buffer,
+                                              juce::MidiBuffer& midiMessages)
+{
+    juce::ignoreUnused (midiMessages);
+    process (buffer);
+}
+
+template <typename SampleType>
+void PluginProcessor::process(juce::AudioBuffer<SampleType>& buffer) {
+    LSP_REALTIME_SECTION ("processBlock");
+    auto renderStart = juce::Time::getHighResolutionTicks();
 
     juce::ScopedNoDenormals noDenormals;
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
     auto numSamples = buffer.getNumSamples();
+    if (numSamples == 0)
+        return;
+    LSP_TRACE_SPAN_VALUE (trace, "processBlock", numSamples);
 
     // In case we have more outputs than inputs, this code clears any output
     // channels that didn't contain input data, (because these aren't
@@ -208,112 +469,447 @@ void PluginProcessor::processBlock (juce::AudioBuffer<float>& buffer,
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, numSamples);
 
-    // save dryMix and wetMix before updating them for smoothing later
-    auto oldDryMix = dryMix;
-    auto oldWetMix = wetMix;
+    // releaseResources() freed the engine, the host has to prepare it again before it plays
+    if (!preparedLayout.has_value()) {
+        buffer.clear();
+        return;
+    }
 
-    auto sampleRate = getSampleRate();
-    updateParameters(sampleRate);
+    if (rateConverter.getFactor() == 1) {
+        processEngine(juce::dsp::AudioBlock<SampleType>(buffer), renderStart);
+        return;
+    }
 
-    auto wetBuffer = juce::AudioBuffer<float>(
-        totalNumInputChannels, 
-        numSamples
-    );
-    wetBuffer.clear();
-
-    auto bufferCopy = juce::AudioBuffer<float>();
-    bufferCopy.makeCopyOf(buffer);
-    auto delayNumSamples = (int)ceil(delayTime * sampleRate);
-
-    while (currentGrainOffset <= numSamples) {
-        // Add fresh grains to the queue
-        auto adsr = juce::ADSR();
-        adsr.setParameters({grainAttack, grainDecay, grainSustain, grainRelease});
-        adsr.setSampleRate(sampleRate);
-        auto normalizedAddedOffset = lsp::SharedResources::random.nextFloat() - 0.5f;
-        auto addedOffsetSamples = (int)(delayTimeVar * sampleRate * normalizedAddedOffset);
-        auto rev = lsp::SharedResources::random.nextBool();
-        auto shiftPitch = lsp::SharedResources::random.nextBool();
-        futureGrainQueue.push_back(lsp::Grain(currentGrainOffset, delayNumSamples, adsr, sampleRate, rev, shiftPitch));
-        currentGrainOffset += grainPeriod + (addedOffsetSamples > 0 ? addedOffsetSamples : 0);
-    }
-
-    for (auto& g: futureGrainQueue) {
-        if (g.lengthInSamples + g.sampleOffset < 0 && !g.readyToPlay) {
-            // put data from dBuffer into the not yet playing grains that have their content just recorded
-            g.internalBuffer.setSize(totalNumInputChannels, g.lengthInSamples);
-            
-            for (int channel = 0; channel < totalNumInputChannels; channel++){
-                auto delayDataPointer = delayBuffers[channel].getWritePointer() + delayBuffers[channel].size() - delayNumSamples;    
-                g.internalBuffer.copyFrom(
-                    channel, 0, 
-                    delayBuffers[channel].data(delayDataPointer + g.sampleOffset), 
-                    g.lengthInSamples
-                );
-            }
-            g.readyToPlay = true;
-            g.applyADSR();
-        } 
+    // At a reduced rate the engine processes the decimated input in place, in chunks no longer
+    // than the converter was prepared for. A chunk shorter than the factor can leave it nothing to do
+    auto& engine = getBuffers<SampleType>().engine;
+    auto maxChunkLength = rateConverter.getMaxHostBlockSize();
+    for (int start = 0; start < numSamples; start += maxChunkLength) {
+        auto chunkLength = juce::jmin(maxChunkLength, numSamples - start);
+        auto numEngineSamples = 0;
+        {
+            LSP_TRACE_SPAN (trace, "decimate");
+            numEngineSamples = rateConverter.decimate(buffer.getArrayOfReadPointers(), start, totalNumInputChannels, chunkLength, engine.getArrayOfWritePointers());
+        }
+        if (numEngineSamples > 0) {
+            processEngine(juce::dsp::AudioBlock<SampleType>(engine).getSubBlock(0, (size_t)numEngineSamples), renderStart);
+        }
+        {
+            LSP_TRACE_SPAN (trace, "interpolate");
+            rateConverter.interpolate(engine.getArrayOfReadPointers(), numEngineSamples, buffer.getArrayOfWritePointers(), start, totalNumInputChannels, chunkLength);
+        }
+        renderStart = juce::Time::getHighResolutionTicks();
     }
+}
 
-    for (auto& g: futureGrainQueue) {
-        // skip grain if the contents arent saved yet
-        if (!g.readyToPlay)
-            continue;
+template <typename SampleType>
+void PluginProcessor::processEngine(juce::dsp::AudioBlock<SampleType> block, juce::int64 renderStart) {
+    auto totalNumInputChannels = getTotalNumInputChannels();
+    auto numSamples = (int)block.getNumSamples();
+    auto sampleRate = engineSampleRate;
+    blockCounters = { 0, 0, grainPool.getNumStolen() };
+    {
+        LSP_TRACE_SPAN (trace, "parameters");
+        updateParameters(sampleRate);
+    }
 
-        if (g.progress == 0 && g.delayNumSamples + g.sampleOffset < 0 && !g.isPlaying) {
-            g.progress = g.lengthInSamples;
-            continue;
+    // asleep, nothing runs until the input makes a sound again, and then from that very sample on
+    auto awakeStart = 0;
+    if (sleeping) {
+        awakeStart = findFirstAudibleSample(block, totalNumInputChannels);
+        sleep(block, awakeStart);
+        sleeping = awakeStart == numSamples;
+    }
+
+    auto feedbackLevel = 0.0f;
+    if (!sleeping) {
+        // refers to the rest of the block, nothing is copied
+        auto awake = block.getSubBlock((size_t)awakeStart);
+        auto numAwake = numSamples - awakeStart;
+        renderBlock(awake, totalNumInputChannels, sampleRate);
+        auto& buffers = getBuffers<SampleType>();
+        feedbackLevel = (float)buffers.wet.getMagnitude(0, numAwake) * feedbackSmoother.getCurrentValue();
+        // the dry buffer holds what just went into the delay line, input plus feedback
+        updateSleep(numAwake, (float)buffers.dry.getMagnitude(0, numAwake));
+    }
+
+    auto renderSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - renderStart);
+    // offline renders have no deadline, and have to come out the same every time
+    if (!isNonRealtime()) {
+        cpuGovernor.update(renderSeconds, numSamples);
+    }
+
+    lsp::BlockStats stats;
+    stats.sampleTime = sampleClock;
+    stats.numSamples = numSamples;
+    stats.activeGrains = grainPool.getNumActive();
+    stats.maxGrains = maxGrains;
+    stats.spawned = blockCounters.spawned;
+    stats.stolen = (int)(grainPool.getNumStolen() - blockCounters.stolenBefore);
+    stats.culled = blockCounters.culled;
+    stats.prerendered = blockCounters.prerendered;
+    stats.prerenderMisses = blockCounters.prerenderMisses;
+    stats.renderSeconds = (float)renderSeconds;
+    stats.load = (float)(renderSeconds * sampleRate / numSamples);
+    stats.feedbackLevel = feedbackLevel;
+    stats.sleeping = sleeping;
+    telemetry.push(stats);
+
+    publishGrainCloud(numSamples, sampleRate);
+}
+
+template <typename SampleType>
+void PluginProcessor::renderBlock(juce::dsp::AudioBlock<SampleType> block, int numInputChannels, double sampleRate) {
+    auto numSamples = (int)block.getNumSamples();
+    auto& buffers = getBuffers<SampleType>();
+    {
+        LSP_TRACE_SPAN (trace, "parameters");
+        // per sample values of the smoothed parameters, shared by all channels
+        auto& ramps = buffers.parameterRamps;
+        ramps.setSize(numParameterRamps, numSamples, false, false, true);
+        fillParameterRamp(delayTimeSmoother, ramps, delayTimeRamp, numSamples);
+        fillParameterRamp(feedbackSmoother, ramps, feedbackRamp, numSamples);
+        fillParameterRamp(dryMixSmoother, ramps, dryMixRamp, numSamples);
+        fillParameterRamp(wetMixSmoother, ramps, wetMixRamp, numSamples);
+    }
+
+    {
+        LSP_TRACE_SPAN (trace, "capture");
+        // both buffers are allocated in prepareToPlay, this only reallocates if the host
+        // sends a bigger block than it announced
+        buffers.wet.setSize(numInputChannels, numSamples, false, false, true);
+        buffers.wet.clear();
+
+        buffers.dry.setSize(numInputChannels, numSamples, false, false, true);
+        for (int channel = 0; channel < numInputChannels; channel++)
+            buffers.dry.copyFrom(channel, 0, block.getChannelPointer((size_t)channel), numSamples);
+    }
+
+    spawnGrains<SampleType>(numSamples, sampleRate);
+
+    // The block is rendered in segments that end wherever a grain starts, so every grain starts
+    // at the beginning of a segment. Segments are also never longer than maxSegmentLength, which
+    // keeps the grains that stream through the delay line from reading samples that haven't
+    // been written yet, even if the delay time is shorter than the block.
+    auto segmentStart = 0;
+    while (segmentStart < numSamples) {
+        while (grainScheduler.getNextEventTime() <= sampleClock + segmentStart) {
+            startGrain(grainScheduler.pop());
         }
 
-        if (g.progress == 0 && 
-            g.delayNumSamples + g.sampleOffset < numSamples && 
-            !g.isPlaying
-        ) {
-            // start the grain
-            g.process(wetBuffer, 1.0f, g.delayNumSamples + g.sampleOffset);
-            g.isPlaying = true;
-        } else if (g.progress != 0 && g.delayNumSamples + g.lengthInSamples + g.sampleOffset > 0) {
-            // play the grain
-            g.process(wetBuffer, 1.0f);
+        auto segmentEnd = juce::jmin(numSamples, segmentStart + maxSegmentLength);
+        auto nextEvent = grainScheduler.getNextEventTime() - sampleClock;
+        if (nextEvent < segmentEnd) {
+            segmentEnd = (int)nextEvent;
         }
-        
+
+        renderSegment<SampleType>(segmentStart, segmentEnd - segmentStart, numInputChannels);
+        segmentStart = segmentEnd;
     }
+    sampleClock += numSamples;
 
-    for (int channel = 0; channel < totalNumInputChannels; channel++)
     {
-        // TODO: cover the case that delayNumSamples < numSamples at low delayTime (maybe process sample-by-sample?)
-        auto delayDataPointer = delayBuffers[channel].getWritePointer() + delayBuffers[channel].size() - delayNumSamples;
-        bufferCopy.addFrom(channel, 0, wetBuffer, channel, 0, numSamples, feedback);
-        delayBuffers[channel].push(bufferCopy.getReadPointer(channel), numSamples);
-    }
-    buffer.applyGainRamp(0, numSamples, oldDryMix, dryMix);
-    wetBuffer.applyGainRamp(0, numSamples, oldWetMix, wetMix);
-    for (int channel = 0; channel < totalNumInputChannels; channel++)
-    {
-        buffer.addFrom(channel, 0, wetBuffer, channel, 0, numSamples);
+        LSP_TRACE_SPAN (trace, "output");
+        for (int channel = 0; channel < (int)block.getNumChannels(); channel++)
+        {
+            juce::FloatVectorOperations::multiply(block.getChannelPointer((size_t)channel), buffers.parameterRamps.getReadPointer(dryMixRamp), numSamples);
+        }
+        for (int channel = 0; channel < numInputChannels; channel++)
+        {
+            juce::FloatVectorOperations::addWithMultiply(
+                block.getChannelPointer((size_t)channel),
+                buffers.wet.getReadPointer(channel),
+                buffers.parameterRamps.getReadPointer(wetMixRamp),
+                numSamples);
+        }
+    }
+}
+
+template <typename SampleType>
+int PluginProcessor::findFirstAudibleSample(juce::dsp::AudioBlock<SampleType> block, int numChannels) const {
+    auto first = (int)block.getNumSamples();
+    for (int channel = 0; channel < numChannels; channel++) {
+        const auto* samples = block.getChannelPointer((size_t)channel);
+        // the vectorised check settles most sleeping blocks
+        auto range = juce::FloatVectorOperations::findMinAndMax(samples, first);
+        if (juce::jmax(-range.getStart(), range.getEnd()) <= (SampleType)silenceThreshold) {
+            continue;
+        }
+        for (int i = 0; i < first; i++) {
+            if (std::abs(samples[i]) > (SampleType)silenceThreshold) {
+                first = i;
+                break;
+            }
+        }
+    }
+    return first;
+}
+
+template <typename SampleType>
+void PluginProcessor::sleep(juce::dsp::AudioBlock<SampleType> block, int numSamples) {
+    LSP_TRACE_SPAN_VALUE (trace, "sleep", numSamples);
+    // The engine is paused: the sample clock, the delay line and the spawn times stay where they
+    // are, so it picks up exactly where it left off. The wet signal is silent and the input is
+    // below the threshold, it only gets the dry gain. The smoothers keep moving, so waking up
+    // doesn't start with a stale ramp
+    delayTimeSmoother.skip(numSamples);
+    feedbackSmoother.skip(numSamples);
+    wetMixSmoother.skip(numSamples);
+    auto dryGain = (SampleType)dryMixSmoother.getCurrentValue();
+    auto endGain = (SampleType)dryMixSmoother.skip(numSamples);
+    if (numSamples == 0)
+        return;
+    // the same ramp AudioBuffer::applyGainRamp applies
+    auto increment = (endGain - dryGain) / (SampleType)numSamples;
+    for (size_t channel = 0; channel < block.getNumChannels(); channel++) {
+        auto* samples = block.getChannelPointer(channel);
+        auto gain = dryGain;
+        for (int i = 0; i < numSamples; i++) {
+            samples[i] *= gain;
+            gain += increment;
+        }
+    }
+}
+
+void PluginProcessor::clearGrains() {
+    // the playing grains give their prerendered slots back, the scheduled ones' slots are cancelled
+    grainPool.clear();
+    grainScheduler.clear();
+    prerenderer.cancelAll();
+}
+
+void PluginProcessor::updateSleep(int numSamples, float writtenLevel) {
+    if (writtenLevel > silenceThreshold) {
+        silentSamples = 0;
+        return;
+    }
+    silentSamples += numSamples;
+    // Once everything a grain can read is below the threshold, every grain, playing, pending or
+    // yet to be spawned, can only read silence, and the feedback loop can only write silence back.
+    // The feedback is in writtenLevel, the silence only starts once its tail died down. New grains
+    // read back as far as the current settings allow, the ones spawned before the delay was
+    // shortened can reach further, they're checked one by one
+    if (silentSamples < delayLine.getLength()) {
+        if (silentSamples < getMaxReadDistance()) {
+            return;
+        }
+        // grains read interpolation::margin frames before their source
+        auto silentSince = sampleClock - silentSamples + lsp::interpolation::margin;
+        if (grainScheduler.getEarliestSourceStart() < silentSince) {
+            return;
+        }
+        for (const auto* grain : grainPool.getActiveGrains()) {
+            if (grain->sourceStart < silentSince) {
+                return;
+            }
+        }
+    }
+    LSP_TRACE_INSTANT (trace, "fall asleep", (double)silentSamples);
+    clearGrains();
+    sleeping = true;
+}
+
+template <typename SampleType>
+void PluginProcessor::spawnGrains(int numSamples, double sampleRate) {
+    LSP_TRACE_SPAN (trace, "spawn");
+    const auto* delayTimes = getBuffers<SampleType>().parameterRamps.getReadPointer(delayTimeRamp);
+    // every spawn draws two values, generate them for the whole block in one go
+    auto maxSpawns = numSamples / grainPeriod + 1;
+    random.refill(juce::jmin(2 * maxSpawns, randomBatchSize));
+    auto prerender = backgroundRender && prerenderer.isPrepared() && !isNonRealtime();
+    if (prerenderer.isPrepared()) {
+        prerenderer.update(sampleClock + numSamples);
+    }
+
+    while (nextSpawnTime < sampleClock + numSamples) {
+        // each grain gets the delay time of the sample it's spawned at
+        auto offset = (int)juce::jlimit((juce::int64)0, (juce::int64)numSamples - 1, nextSpawnTime - sampleClock);
+        auto delayNumSamples = (int)ceil(delayTimes[offset] * sampleRate);
+        auto normalizedAddedOffset = random.nextFloat() - 0.5f;
+        auto addedOffsetSamples = (int)(delayTimeVar * sampleRate * normalizedAddedOffset);
+        // reverse and pitch come from the top bits of one value
+        auto decisions = random.nextInt();
+        auto rev = (decisions & 0x80000000u) != 0;
+        auto shiftPitch = (decisions & 0x40000000u) != 0;
+
+        lsp::GrainEvent event;
+        event.startTime = nextSpawnTime + delayNumSamples;
+        event.envelope = grainEnvelope;
+        event.reversed = rev;
+        // under load the governor makes new grains cheaper
+        event.rate = cpuGovernor.limitRate(shiftPitch ? pitchShift : 1.0f);
+        event.interpolation = cpuGovernor.limitInterpolation(interpolation);
+        // the grain plays what came in delayNumSamples before it was spawned
+        event.sourceStart = nextSpawnTime - delayNumSamples;
+        if (rev || event.rate > 1.0f) {
+            // these read ahead of the playhead, so their whole content has to be
+            // in the delay line by the time they start
+            auto sourceLength = lsp::Grain::getSourceLength(grainEnvelope->lengthInSamples, event.rate);
+            event.sourceStart = juce::jmin(event.sourceStart, event.startTime - sourceLength);
+        }
+        if (!cpuGovernor.shouldSpawn()) {
+            blockCounters.culled++;
+        } else {
+            // grains whose whole source is in the delay line already and that start after this
+            // block get rendered in the background, if there's a slot
+            auto sourceEnd = event.sourceStart + lsp::Grain::getSourceLength(grainEnvelope->lengthInSamples, event.rate);
+            event.prerenderSlot = prerender && sourceEnd <= sampleClock && event.startTime >= sampleClock + numSamples
+                ? prerenderer.acquire()
+                : -1;
+            if (!grainScheduler.schedule(event)) {
+                blockCounters.culled++;
+                if (event.prerenderSlot >= 0) {
+                    prerenderer.release(event.prerenderSlot);
+                }
+            } else if (event.prerenderSlot >= 0) {
+                prerenderer.submit(event.prerenderSlot, event, sampleClock);
+            }
+        }
+
+        nextSpawnTime += grainPeriod + (addedOffsetSamples > 0 ? addedOffsetSamples : 0);
+    }
+}
+
+int PluginProcessor::getMaxReadDistance() const {
+    // the bound getEngineLayout sizes the delay line for, at the current settings instead of
+    // the parameters' maxima, with the spawn time variation on top to stay on the safe side
+    auto delayNumSamples = (int)ceil((juce::jmax(delayTimeSmoother.getCurrentValue(), delayTimeSmoother.getTargetValue()) + delayTimeVar) * engineSampleRate);
+    auto grainLength = grainEnvelope != nullptr ? grainEnvelope->lengthInSamples : 0;
+    auto sourceLength = lsp::Grain::getSourceLength(grainLength, juce::jmax(1.0f, pitchShift));
+    return grainLength + juce::jmax(2 * delayNumSamples, sourceLength) + lsp::interpolation::margin;
+}
+
+void PluginProcessor::publishGrainCloud(int numSamples, double sampleRate) {
+    if (!grainCloudVisible.load(std::memory_order_relaxed)) {
+        return;
+    }
+    samplesUntilGrainCloud -= numSamples;
+    if (samplesUntilGrainCloud > 0) {
+        return;
+    }
+    samplesUntilGrainCloud = (int)(sampleRate / grainCloudRate);
+
+    auto& cloud = grainCloud.getWriteBuffer();
+    const auto& grains = grainPool.getActiveGrains();
+    cloud.sampleTime = sampleClock;
+    cloud.sampleRate = sampleRate;
+    cloud.historyLength = delayLine.getLength();
+    cloud.delayNumSamples = (int)ceil(delayTimeSmoother.getCurrentValue() * sampleRate);
+    cloud.numActive = (int)grains.size();
+    cloud.numGrains = juce::jmin(cloud.numActive, lsp::GrainCloud::maxGrains);
+    for (int i = 0; i < cloud.numGrains; i++) {
+        const auto& grain = *grains[(size_t)i];
+        auto& view = cloud.grains[(size_t)i];
+        view.age = (int)(sampleClock - grain.startTime);
+        view.length = grain.lengthInSamples;
+        view.sourceDistance = (int)(sampleClock - grain.sourceStart);
+        view.sourceLength = grain.getSourceLength();
+        view.rate = grain.rate;
+        view.level = grain.envelopeLevel;
+        view.reversed = grain.reversed;
+    }
+    grainCloud.publish();
+}
+
+void PluginProcessor::startGrain(const lsp::GrainEvent& event) {
+    auto stolenBefore = grainPool.getNumStolen();
+    auto& grain = grainPool.acquire(maxGrains, grainStealing);
+    // a stolen grain gets no end event, the steal marks where it was cut off
+    if (grainPool.getNumStolen() != stolenBefore) {
+        LSP_TRACE_INSTANT (trace, "steal", (double)(grainPool.getNumStolen() - stolenBefore));
+    }
+    grain.reset(event.startTime, event.sourceStart, *event.envelope, event.reversed, event.rate, event.interpolation);
+    if (event.prerenderSlot >= 0) {
+        if (prerenderer.attach(grain, event.prerenderSlot)) {
+            blockCounters.prerendered++;
+        } else {
+            // the background thread didn't make it in time, the grain gets mixed here like any other
+            LSP_TRACE_INSTANT (trace, "prerender missed", (double)grain.serial);
+            blockCounters.prerenderMisses++;
+        }
+    }
+    LSP_TRACE_BEGIN_ASYNC (trace, "grain", grain.serial, event.rate);
+    numGrainsRendered++;
+    blockCounters.spawned++;
+}
+
+template <typename SampleType>
+void PluginProcessor::renderGrains(int startSample, int numSamples) {
+    const auto& grains = grainPool.getActiveGrains();
+    auto& buffers = getBuffers<SampleType>();
+    // envelopes and pitch shifting are fused into the mixer's kernels, so this covers both
+    LSP_TRACE_SPAN_VALUE (trace, "mix", (double)grains.size());
+    auto historyEnd = sampleClock + startSample;
+    auto numTasks = ((int)grains.size() + grainsPerRenderTask - 1) / grainsPerRenderTask;
+
+    // a single task would be summed in the same order anyway, so it's rendered straight into
+    // the wet buffer, as are blocks bigger than the host announced
+    if (!parallelRender || numTasks < 2 || numTasks > (int)buffers.renderPartials.size()
+        || numSamples > buffers.renderPartials[0].getNumSamples()) {
+        grainMixer.process(grains.data(), (int)grains.size(), buffers.wet, startSample, numSamples, delayLine, historyEnd);
+        return;
+    }
+
+    auto renderTask = [this, numSamples, historyEnd] (int task) {
+        renderGrainTask<SampleType>(task, numSamples, historyEnd);
+    };
+    // another instance is using the threads, render the same tasks here instead
+    if (!renderThreads->run(numTasks, maxRenderThreads, renderTask)) {
+        for (int task = 0; task < numTasks; task++) {
+            renderTask(task);
+        }
     }
 
-    // Remove the grains that have finished playing
-    auto isGrainActive = [](lsp::Grain g){ return g.progress == g.lengthInSamples;};
-    futureGrainQueue.erase(
-        std::remove_if(begin(futureGrainQueue), end(futureGrainQueue), isGrainActive),
-        end(futureGrainQueue)
-    );
-    
-    // subtract numSamples from sampleOffset of all grains (make grains "older")
-    for (auto& g: futureGrainQueue) {
-        g.sampleOffset -= numSamples;
+    for (int task = 0; task < numTasks; task++) {
+        for (int channel = 0; channel < buffers.wet.getNumChannels(); channel++) {
+            buffers.wet.addFrom(channel, startSample, buffers.renderPartials[(size_t)task], channel, 0, numSamples);
+        }
     }
+}
+
+template <typename SampleType>
+void PluginProcessor::renderGrainTask(int task, int numSamples, juce::int64 historyEnd) {
+    // every grain belongs to exactly one task, so tasks never touch the same grain
+    const auto& grains = grainPool.getActiveGrains();
+    auto& partial = getBuffers<SampleType>().renderPartials[(size_t)task];
+    partial.clear(0, numSamples);
+    auto first = task * grainsPerRenderTask;
+    auto numGrains = juce::jmin((int)grains.size() - first, grainsPerRenderTask);
+    renderMixers[task]->process(grains.data() + first, numGrains, partial, 0, numSamples, delayLine, historyEnd);
+}
+
+template <typename SampleType>
+void PluginProcessor::renderSegment(int startSample, int numSamples, int numChannels) {
+    // all playing grains first, they only read what's already in the delay line
+    renderGrains<SampleType>(startSample, numSamples);
 
-    currentGrainOffset -= numSamples;
+    // then input plus feedback goes into the delay line, so the next segment can read it
+    {
+        LSP_TRACE_SPAN (trace, "feedback");
+        auto& buffers = getBuffers<SampleType>();
+        for (int channel = 0; channel < numChannels; channel++)
+        {
+            juce::FloatVectorOperations::addWithMultiply(
+                buffers.dry.getWritePointer(channel, startSample),
+                buffers.wet.getReadPointer(channel, startSample),
+                buffers.parameterRamps.getReadPointer(feedbackRamp, startSample),
+                numSamples);
+        }
+        delayLine.push(buffers.dry.getArrayOfReadPointers(), startSample, numSamples);
+    }
 
-    if (debugFlag) {
-        // TODO: remove this, this is bad :)
-        // (use DBG to print something)
-        apvts.getParameter("DEBUG")->setValue(false);
-        debugFlag = false;
+    // Return the grains that have finished playing to the pool
+    LSP_TRACE_SPAN (trace, "cleanup");
+   #if LSP_TRACING
+    if (trace.isEnabled()) {
+        for (auto* grain : grainPool.getActiveGrains()) {
+            if (grain->isFinished()) {
+                trace.endAsync("grain", grain->serial);
+            }
+        }
     }
+   #endif
+    grainPool.releaseFinished();
 }
 
 //==============================================================================
@@ -1,8 +1,19 @@
 #pragma once
 
 #include <juce_audio_processors/juce_audio_processors.h>
-#include <chowdsp_data_structures/chowdsp_data_structures.h>
-#include "Grain.h"
+#include <juce_dsp/juce_dsp.h>
+#include "GrainPool.h"
+#include "GrainMixer.h"
+#include "GrainPrerenderer.h"
+#include "CpuGovernor.h"
+#include "Xoshiro.h"
+#include "GrainScheduler.h"
+#include "SharedResources.h"
+#include "Telemetry.h"
+#include "Trace.h"
+#include "GrainCloud.h"
+#include "TripleBuffer.h"
+#include "RateConverter.h"
 
 #if (MSVC)
 #include "ipps.h"
@@ -20,6 +31,10 @@ public:
     bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    // the engine is templated on the sample type, so a double precision host gets a double
+    // path all the way through instead of converting around the plugin
+    bool supportsDoublePrecisionProcessing() const override { return true; }
 
     juce::AudioProcessorEditor* createEditor() override;
     bool hasEditor() const override;
@@ -40,17 +55,156 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
+    // number of grains that started playing since the processor was created
+    juce::uint64 getNumGrainsRendered() const { return numGrainsRendered; }
+    // caps how many threads (the audio thread included) render grains when parallelRender is on
+    void setMaxRenderThreads(int numThreads) { maxRenderThreads = numThreads; }
+    int getMaxRenderThreads() const { return maxRenderThreads; }
+    // current degradation level and load, safe to read from the message thread
+    const lsp::CpuGovernor& getCpuGovernor() const { return cpuGovernor; }
+    // per block statistics published by the audio thread, read them with getSnapshot()
+    lsp::Telemetry& getTelemetry() { return telemetry; }
+    // spans of the processBlock phases and grain lifetimes, only recorded in LSP_TRACING builds
+    lsp::Trace& getTrace() { return trace; }
+    // snapshots of the playing grains for the editor, only published while it's visible
+    void setGrainCloudVisible(bool isVisible) { grainCloudVisible.store(isVisible, std::memory_order_relaxed); }
+    bool isGrainCloudVisible() const { return grainCloudVisible.load(std::memory_order_relaxed); }
+    lsp::TripleBuffer<lsp::GrainCloud>& getGrainCloud() { return grainCloud; }
+    // true while the input and the whole delay line are silent and processBlock skips the engine
+    bool isSleeping() const { return sleeping; }
+    // the rate the grains, the delay line and the feedback run at, below the host's with engineRate on reduced
+    double getEngineSampleRate() const { return engineSampleRate; }
+
+    // the widest bus layout isBusesLayoutSupported accepts
+    static constexpr int maxChannels = 64;
+
 private:
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PluginProcessor)
 
     juce::AudioProcessorValueTreeState::ParameterLayout getParameterLayout();
-    void updateParameters(int sampleRate);
+    void updateParameters(double sampleRate);
 
     juce::AudioProcessorValueTreeState apvts;
-    void updateDelayBufferSizes(int);
+    float getMaxGrainLength();
+
+    // Everything prepareToPlay allocates memory for, worked out before anything is touched.
+    // A prepare with the layout the engine already has only resets its state
+    struct EngineLayout {
+        double hostSampleRate = 0.0;
+        int hostBlockSize = 0;
+        // the engine runs at the host rate divided by this, see reducedEngineRate
+        int engineRateFactor = 1;
+        // the engine's rate and largest block, everything below is sized for these
+        double sampleRate = 0.0;
+        int blockSize = 0;
+        int numInputChannels = 0;
+        bool doublePrecision = false;
+        // the delay line's channels, frames and storage
+        int numChannels = 0;
+        int maxHistoryLength = 0;
+        lsp::DelayPrecision delayPrecision = lsp::DelayPrecision::Float32;
+        int maxGrainLength = 0;
+        int grainPoolCapacity = 0;
+        int schedulerCapacity = 0;
+        int randomBatchSize = 0;
+        int maxRenderTasks = 0;
+
+        bool operator==(const EngineLayout&) const = default;
+    };
+    EngineLayout getEngineLayout(double hostSampleRate, int hostBlockSize);
+    // (re)allocates whatever differs from the prepared layout
+    void allocate(const EngineLayout& layout);
 
     template <typename T>
-    void updateParameter(T& paramRef, const char* parameterName);
+    void updateParameter(T& paramRef, const std::atomic<float>* parameter);
+    template <typename SampleType>
+    void fillParameterRamp(juce::SmoothedValue<float>& smoother, juce::AudioBuffer<SampleType>& ramps, int ramp, int numSamples);
+    // restarts the random stream from the seed parameter, or from the clock if it's 0
+    void reseed();
+
+    // Everything a block is rendered through, in the precision the host processes in.
+    // Only the set for the precision prepareToPlay was called with is allocated
+    template <typename SampleType>
+    struct BlockBuffers {
+        // one channel per smoothed parameter, filled at the start of every block
+        juce::AudioBuffer<SampleType> parameterRamps;
+        juce::AudioBuffer<SampleType> wet;
+        // input plus feedback, this is what gets written into the delay line
+        juce::AudioBuffer<SampleType> dry;
+        // one per render task in parallel mode
+        std::vector<juce::AudioBuffer<SampleType>> renderPartials;
+        // the decimated input the engine processes in place, only used at a reduced engine rate
+        juce::AudioBuffer<SampleType> engine;
+
+        void prepare(int numChannels, int numSamples, int numRenderTasks, bool reducedRate);
+    };
+    template <typename SampleType>
+    BlockBuffers<SampleType>& getBuffers();
+
+    // The render path below is templated on the sample type and instantiated
+    // for both processBlock overloads. Parts of a block are passed around as dsp::AudioBlocks:
+    // a referencing AudioBuffer allocates its channel array above 31 channels
+    template <typename SampleType>
+    void process(juce::AudioBuffer<SampleType>& buffer);
+    // everything process() does at the engine rate, for a whole block or, at a reduced
+    // engine rate, for the decimated input of one
+    template <typename SampleType>
+    void processEngine(juce::dsp::AudioBlock<SampleType> block, juce::int64 renderStart);
+    // schedules every grain that gets spawned within the current block
+    template <typename SampleType>
+    void spawnGrains(int numSamples, double sampleRate);
+    void startGrain(const lsp::GrainEvent& event);
+    // renders all playing grains into the wet buffer and writes the delay line for one segment of the block
+    template <typename SampleType>
+    void renderSegment(int startSample, int numSamples, int numChannels);
+    // mixes all playing grains into the wet buffer, on the shared render threads if parallelRender is on
+    template <typename SampleType>
+    void renderGrains(int startSample, int numSamples);
+    template <typename SampleType>
+    void renderGrainTask(int task, int numSamples, juce::int64 historyEnd);
+    // everything processBlock does while awake, for the whole buffer
+    template <typename SampleType>
+    void renderBlock(juce::dsp::AudioBlock<SampleType> block, int numInputChannels, double sampleRate);
+    // index of the first sample above silenceThreshold on any channel, or the buffer's length
+    template <typename SampleType>
+    int findFirstAudibleSample(juce::dsp::AudioBlock<SampleType> block, int numChannels) const;
+    // the first numSamples of the buffer while asleep
+    template <typename SampleType>
+    void sleep(juce::dsp::AudioBlock<SampleType> block, int numSamples);
+    // drops every playing and scheduled grain
+    void clearGrains();
+    // counts the silence written into the delay line (writtenLevel is the peak of what went in)
+    // and falls asleep once it covers everything a grain can still read
+    void updateSleep(int numSamples, float writtenLevel);
+    // how far back a grain spawned with the current settings reads, from the moment it ends
+    int getMaxReadDistance() const;
+    // fills and publishes the next grain cloud snapshot, at most grainCloudRate times per second
+    void publishGrainCloud(int numSamples, double sampleRate);
+
+    // the apvts' raw values, cached so the audio thread never has to look them up by name
+    struct RawParameters {
+        std::atomic<float>* grainRate = nullptr;
+        std::atomic<float>* grainAttack = nullptr;
+        std::atomic<float>* grainDecay = nullptr;
+        std::atomic<float>* grainSustain = nullptr;
+        std::atomic<float>* grainRelease = nullptr;
+        std::atomic<float>* grainWindow = nullptr;
+        std::atomic<float>* pitchShift = nullptr;
+        std::atomic<float>* interpolation = nullptr;
+        std::atomic<float>* delayTime = nullptr;
+        std::atomic<float>* delayTimeVar = nullptr;
+        std::atomic<float>* feedback = nullptr;
+        std::atomic<float>* dryMix = nullptr;
+        std::atomic<float>* wetMix = nullptr;
+        std::atomic<float>* maxGrains = nullptr;
+        std::atomic<float>* grainStealing = nullptr;
+        std::atomic<float>* parallelRender = nullptr;
+        std::atomic<float>* backgroundRender = nullptr;
+        std::atomic<float>* cpuBudget = nullptr;
+        std::atomic<float>* seed = nullptr;
+        std::atomic<float>* delayPrecision = nullptr;
+        std::atomic<float>* engineRate = nullptr;
+    } rawParameters;
 
     float dryMix;
     float wetMix;
@@ -63,9 +217,86 @@ private:
     float grainSustain;
     float grainRelease;
     float grainRate;
+    lsp::WindowShape grainWindow = lsp::WindowShape::ADSR;
+    float pitchShift;
+    lsp::InterpolationType interpolation = lsp::InterpolationType::Cubic;
+    int maxGrains;
+    lsp::StealingPolicy grainStealing = lsp::StealingPolicy::Oldest;
+    bool parallelRender = false;
+    bool backgroundRender = true;
+    int seed = 0;
     
-    int currentGrainOffset = 0;
-    bool debugFlag;
-    std::vector<chowdsp::DoubleBuffer<float>> delayBuffers;    
-    std::vector<lsp::Grain> futureGrainQueue = {};
+    static constexpr double parameterSmoothingTime = 0.05;
+    juce::SmoothedValue<float> delayTimeSmoother;
+    juce::SmoothedValue<float> feedbackSmoother;
+    juce::SmoothedValue<float> dryMixSmoother;
+    juce::SmoothedValue<float> wetMixSmoother;
+    // channels of BlockBuffers::parameterRamps
+    enum ParameterRamp { delayTimeRamp, feedbackRamp, dryMixRamp, wetMixRamp, numParameterRamps };
+
+    // With engineRate set to reduced, host rates of 88.2 kHz and above are divided down by
+    // the largest integer factor that keeps the engine at or above this rate
+    static constexpr double reducedEngineRate = 44100.0;
+    static constexpr int maxEngineRateFactor = 8;
+    // the rate everything except the converter runs at
+    double engineSampleRate = 44100.0;
+    // decimates the input to the engine rate and brings the output back up, does nothing at a factor of 1
+    lsp::RateConverter rateConverter;
+
+    // absolute time of the first sample of the current block
+    juce::int64 sampleClock = 0;
+    juce::int64 nextSpawnTime = 0;
+    int maxSegmentLength = 1;
+    // input plus feedback of every channel, frame packed
+    lsp::DelayLine delayLine;
+    juce::uint64 numGrainsRendered = 0;
+    lsp::GrainPool grainPool;
+    lsp::GrainScheduler grainScheduler;
+    lsp::CpuGovernor cpuGovernor;
+    lsp::Telemetry telemetry;
+    lsp::Trace trace;
+    // anything below -100 dB counts as silence
+    static constexpr float silenceThreshold = 1.0e-5f;
+    bool sleeping = false;
+    // how long the delay line has only been written silence
+    int silentSamples = 0;
+    // the reported tail ends once the feedback brought it below -80 dB
+    static constexpr double tailThreshold = 1.0e-4;
+    static constexpr double maxTailSeconds = 60.0;
+
+    static constexpr double grainCloudRate = 30.0;
+    std::atomic<bool> grainCloudVisible { false };
+    int samplesUntilGrainCloud = 0;
+    lsp::TripleBuffer<lsp::GrainCloud> grainCloud;
+    // what happened in the current block, for the telemetry
+    struct BlockCounters {
+        int spawned = 0;
+        int culled = 0;
+        juce::uint64 stolenBefore = 0;
+        int prerendered = 0;
+        int prerenderMisses = 0;
+    } blockCounters;
+    // jitter, reverse and pitch decisions of every spawned grain
+    lsp::Xoshiro random;
+    int randomBatchSize = 256;
+    lsp::EnvelopeCache envelopeCache;
+    // table for the current grain shape, owned by envelopeCache
+    lsp::EnvelopeTable* grainEnvelope = nullptr;
+    lsp::GrainMixer grainMixer;
+    BlockBuffers<float> floatBuffers;
+    BlockBuffers<double> doubleBuffers;
+
+    // In parallel mode the active grains are split into tasks of grainsPerRenderTask grains.
+    // Each task mixes into its own partial buffer and the partials are summed in task order,
+    // so the output doesn't depend on how many threads ran or which one got which task
+    static constexpr int grainsPerRenderTask = 16;
+    lsp::SharedResources::RenderThreads renderThreads;
+    int maxRenderThreads = lsp::RenderThreadPool::maxWorkers + 1;
+    juce::OwnedArray<lsp::GrainMixer> renderMixers;
+    // renders grains whose source is complete on a background thread before they start,
+    // only in single precision (its slots are float) and never offline (the output has to
+    // come out the same every time)
+    lsp::GrainPrerenderer prerenderer;
+    // what the engine is allocated for, empty before the first prepareToPlay and after releaseResources
+    std::optional<EngineLayout> preparedLayout;
 };
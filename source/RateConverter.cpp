@@ -0,0 +1,165 @@
+#include "RateConverter.h"
+
+namespace lsp {
+    namespace {
+        // zeroth order modified Bessel function of the first kind, for the Kaiser window
+        double besselI0(double x) {
+            auto sum = 1.0;
+            auto term = 1.0;
+            for (int k = 1; k < 50 && term > 1.0e-12 * sum; k++) {
+                term *= (x / (2.0 * k)) * (x / (2.0 * k));
+                sum += term;
+            }
+            return sum;
+        }
+
+        // about 80 dB of stopband attenuation
+        constexpr double kaiserBeta = 8.0;
+    }
+
+    void RateConverter::prepare(int newNumChannels, int newFactor, int newMaxHostBlockSize) {
+        factor = juce::jmax(1, newFactor);
+        numChannels = newNumChannels;
+        maxHostBlockSize = newMaxHostBlockSize;
+        if (factor == 1) {
+            std::vector<double>().swap(kernel);
+            std::vector<double>().swap(phases);
+            std::vector<double>().swap(decimatorHistory);
+            std::vector<double>().swap(interpolatorHistory);
+            std::vector<double>().swap(fifo);
+            tapsPerPhase = 0;
+            fifoSize = 0;
+            return;
+        }
+
+        // cut off at the engine's Nyquist frequency, which is 0.5 / factor of the host rate
+        auto length = 2 * zeroCrossings * factor + 1;
+        auto centre = (length - 1) / 2;
+        kernel.resize((size_t)length);
+        auto sum = 0.0;
+        for (int k = 0; k < length; k++) {
+            auto x = (double)(k - centre) / factor;
+            auto sinc = x == 0.0 ? 1.0 : std::sin(juce::MathConstants<double>::pi * x) / (juce::MathConstants<double>::pi * x);
+            auto window = (double)(k - centre) / centre;
+            kernel[(size_t)k] = sinc * besselI0(kaiserBeta * std::sqrt(1.0 - window * window)) / besselI0(kaiserBeta);
+            sum += kernel[(size_t)k];
+        }
+        for (auto& tap : kernel) {
+            tap /= sum;
+        }
+
+        // upsampled output sample p of each engine sample j sums kernel[p + q * factor] * engine[j - q]
+        tapsPerPhase = (length + factor - 1) / factor;
+        phases.assign((size_t)(factor * tapsPerPhase), 0.0);
+        for (int p = 0; p < factor; p++) {
+            for (int q = 0; q < tapsPerPhase && p + q * factor < length; q++) {
+                phases[(size_t)(p * tapsPerPhase + tapsPerPhase - 1 - q)] = factor * kernel[(size_t)(p + q * factor)];
+            }
+        }
+
+        decimatorHistory.resize((size_t)(numChannels * 2 * length));
+        interpolatorHistory.resize((size_t)(numChannels * 2 * tapsPerPhase));
+        // the silence it starts with plus the most one block can add
+        fifoSize = maxHostBlockSize + 2 * factor;
+        fifo.resize((size_t)(numChannels * fifoSize));
+        reset();
+    }
+
+    void RateConverter::reset() {
+        std::fill(decimatorHistory.begin(), decimatorHistory.end(), 0.0);
+        std::fill(interpolatorHistory.begin(), interpolatorHistory.end(), 0.0);
+        std::fill(fifo.begin(), fifo.end(), 0.0);
+        decimatorPosition = 0;
+        decimatorPhase = 0;
+        interpolatorPosition = 0;
+        fifoRead = 0;
+        // The engine sample for host samples [j * factor, (j + 1) * factor) only exists once the
+        // last of them came in, this much silence covers for the ones before it
+        fifoCount = factor - 1;
+    }
+
+    template <typename SampleType>
+    int RateConverter::decimate(const SampleType* const* input, int startSample, int numInputChannels, int numSamples, SampleType* const* engine) {
+        jassert(factor > 1 && numInputChannels <= numChannels && numSamples <= maxHostBlockSize);
+        auto length = (int)kernel.size();
+        auto numEngineSamples = 0;
+        auto position = decimatorPosition;
+        auto phase = decimatorPhase;
+        // every channel takes the same steps, the last one leaves them where the next block picks up
+        for (int channel = 0; channel < numInputChannels; channel++) {
+            const auto* in = input[channel] + startSample;
+            auto* out = engine[channel];
+            auto* history = decimatorHistory.data() + channel * 2 * length;
+            position = decimatorPosition;
+            phase = decimatorPhase;
+            numEngineSamples = 0;
+            for (int i = 0; i < numSamples; i++) {
+                history[position] = history[position + length] = (double)in[i];
+                position = position + 1 == length ? 0 : position + 1;
+                if (++phase < factor) {
+                    continue;
+                }
+                phase = 0;
+                // the kernel is symmetric, which end of the window is the newest doesn't matter
+                const auto* window = history + position;
+                auto sum = 0.0;
+                for (int k = 0; k < length; k++) {
+                    sum += kernel[(size_t)k] * window[k];
+                }
+                out[numEngineSamples++] = (SampleType)sum;
+            }
+        }
+        decimatorPosition = position;
+        decimatorPhase = phase;
+        return numEngineSamples;
+    }
+
+    template <typename SampleType>
+    void RateConverter::interpolate(const SampleType* const* engine, int numEngineSamples, SampleType* const* output, int startSample, int numOutputChannels, int numSamples) {
+        jassert(factor > 1 && numOutputChannels <= numChannels);
+        jassert(fifoCount + numEngineSamples * factor <= fifoSize);
+        auto position = interpolatorPosition;
+        for (int channel = 0; channel < numOutputChannels; channel++) {
+            const auto* in = engine[channel];
+            auto* history = interpolatorHistory.data() + channel * 2 * tapsPerPhase;
+            auto* ring = fifo.data() + channel * fifoSize;
+            auto write = (fifoRead + fifoCount) % fifoSize;
+            position = interpolatorPosition;
+            for (int j = 0; j < numEngineSamples; j++) {
+                history[position] = history[position + tapsPerPhase] = (double)in[j];
+                position = position + 1 == tapsPerPhase ? 0 : position + 1;
+                // oldest engine sample first, like the phases
+                const auto* window = history + position;
+                for (int p = 0; p < factor; p++) {
+                    const auto* taps = phases.data() + p * tapsPerPhase;
+                    auto sum = 0.0;
+                    for (int q = 0; q < tapsPerPhase; q++) {
+                        sum += taps[q] * window[q];
+                    }
+                    ring[write] = sum;
+                    write = write + 1 == fifoSize ? 0 : write + 1;
+                }
+            }
+        }
+        interpolatorPosition = position;
+        fifoCount += numEngineSamples * factor;
+
+        jassert(numSamples <= fifoCount);
+        for (int channel = 0; channel < numOutputChannels; channel++) {
+            const auto* ring = fifo.data() + channel * fifoSize;
+            auto* out = output[channel] + startSample;
+            auto read = fifoRead;
+            for (int i = 0; i < numSamples; i++) {
+                out[i] = (SampleType)ring[read];
+                read = read + 1 == fifoSize ? 0 : read + 1;
+            }
+        }
+        fifoRead = (fifoRead + numSamples) % fifoSize;
+        fifoCount -= numSamples;
+    }
+
+    template int RateConverter::decimate<float>(const float* const*, int, int, int, float* const*);
+    template int RateConverter::decimate<double>(const double* const*, int, int, int, double* const*);
+    template void RateConverter::interpolate<float>(const float* const*, int, float* const*, int, int, int);
+    template void RateConverter::interpolate<double>(const double* const*, int, double* const*, int, int, int);
+} // namespace lsp
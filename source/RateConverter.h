@@ -0,0 +1,74 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+namespace lsp {
+    // Runs the engine at an integer fraction of the host's sample rate.
+    // The input is low pass filtered and decimated, and the engine's output is zero stuffed and
+    // filtered back up, both with the same linear phase Kaiser windowed sinc. Both are evaluated
+    // polyphase, so only the samples that are kept get computed. Host blocks don't have to be
+    // multiples of the factor: the decimator carries its phase over from block to block, and the
+    // upsampled output goes through a FIFO that starts out with factor - 1 samples of silence,
+    // which is just enough that it never runs dry. The output lags the input by
+    // getLatencyInSamples() host samples.
+    class RateConverter {
+        public:
+        // engine samples the filter spans on either side of its centre
+        static constexpr int zeroCrossings = 24;
+
+        RateConverter() = default;
+        ~RateConverter() = default;
+
+        // a factor of 1 turns the converter off, everything else allocates for blocks of up to
+        // maxHostBlockSize host samples
+        void prepare(int numChannels, int factor, int maxHostBlockSize);
+        // forgets the filter histories and the buffered output, doesn't allocate
+        void reset();
+        // frees everything and goes back to a factor of 1
+        void release() { prepare(0, 1, 0); }
+
+        int getFactor() const { return factor; }
+        int getLatencyInSamples() const { return factor > 1 ? (int)kernel.size() - 1 : 0; }
+        int getMaxHostBlockSize() const { return maxHostBlockSize; }
+        // the most engine samples one decimate() call of up to getMaxHostBlockSize() writes
+        int getMaxEngineBlockSize() const { return maxHostBlockSize / factor + 1; }
+
+        // Filters numSamples host samples of numChannels channels of input from startSample on
+        // and writes every factor-th one to the start of engine, returns how many that were.
+        // Channels are plain pointer arrays, like DelayLine::push takes them, so slicing a
+        // block never builds an AudioBuffer (which allocates above 31 channels)
+        template <typename SampleType>
+        int decimate(const SampleType* const* input, int startSample, int numChannels, int numSamples, SampleType* const* engine);
+        // upsamples numEngineSamples engine samples into the FIFO and takes the next numSamples
+        // host samples out of it, into numChannels channels of output from startSample on
+        template <typename SampleType>
+        void interpolate(const SampleType* const* engine, int numEngineSamples, SampleType* const* output, int startSample, int numChannels, int numSamples);
+
+        private:
+        int factor = 1;
+        int numChannels = 0;
+        int maxHostBlockSize = 0;
+        // low pass at the engine's Nyquist frequency, at the host rate, symmetric
+        std::vector<double> kernel;
+        // the kernel split into factor interpolation phases of tapsPerPhase taps each, oldest
+        // engine sample first, and factor times as loud to make up for the zero stuffing
+        std::vector<double> phases;
+        int tapsPerPhase = 0;
+
+        // Per channel, the newest samples are written twice (at i and i + length), so the filters
+        // always read one contiguous window starting at the current position
+        std::vector<double> decimatorHistory;
+        std::vector<double> interpolatorHistory;
+        int decimatorPosition = 0;
+        int decimatorPhase = 0;
+        int interpolatorPosition = 0;
+
+        // upsampled output waiting to be handed to the host, one ring per channel
+        std::vector<double> fifo;
+        int fifoSize = 0;
+        int fifoRead = 0;
+        int fifoCount = 0;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RateConverter)
+    };
+} // namespace lsp
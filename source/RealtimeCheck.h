@@ -0,0 +1,22 @@
+#pragma once
+
+// Marks code that has to be real-time safe (no heap, no locks).
+// The Tests target builds with LSP_REALTIME_CHECKS=1 and hooks the allocator and mutexes,
+// anything those hooks see while a section is open gets reported as a violation.
+// In the plugin and the benchmarks the macro compiles to nothing.
+#if LSP_REALTIME_CHECKS
+namespace lsp {
+    class ScopedRealtimeSection {
+        public:
+        explicit ScopedRealtimeSection(const char* name);
+        ~ScopedRealtimeSection();
+
+        private:
+        const char* previousName;
+    };
+} // namespace lsp
+
+    #define LSP_REALTIME_SECTION(name) const lsp::ScopedRealtimeSection lspRealtimeSection (name)
+#else
+    #define LSP_REALTIME_SECTION(name)
+#endif
@@ -0,0 +1,122 @@
+#include "RenderThreadPool.h"
+
+namespace lsp {
+    class RenderThreadPool::Worker : public juce::Thread {
+        public:
+        Worker(RenderThreadPool& pool, int index)
+            : juce::Thread("lsp render " + juce::String(index)), pool(pool), index(index) {}
+
+        void run() override {
+            auto seen = pool.generation.load(std::memory_order_acquire);
+            while (!threadShouldExit()) {
+                pool.generation.wait(seen, std::memory_order_acquire);
+                seen = pool.generation.load(std::memory_order_acquire);
+                if (threadShouldExit()) {
+                    break;
+                }
+
+                // join the batch unless the caller already finished it
+                auto value = pool.entry.load(std::memory_order_acquire);
+                auto joined = false;
+                while ((value >> 32) == seen && (value & closedFlag) == 0) {
+                    if (pool.entry.compare_exchange_weak(value, value + 1, std::memory_order_acq_rel)) {
+                        joined = true;
+                        break;
+                    }
+                }
+                if (joined) {
+                    // worker i starts on queue i + 1, queue 0 is the caller's
+                    if (index + 1 < pool.numQueues) {
+                        pool.participate(index + 1);
+                    }
+                    pool.workersLeft.fetch_add(1, std::memory_order_release);
+                }
+            }
+        }
+
+        private:
+        RenderThreadPool& pool;
+        int index;
+    };
+
+    RenderThreadPool::RenderThreadPool() {
+        // leave one core for the host's audio thread, which always takes part itself
+        numWorkers = juce::jlimit(0, maxWorkers, juce::SystemStats::getNumCpus() - 1);
+        for (int i = 0; i < numWorkers; i++) {
+            workers[i] = std::make_unique<Worker>(*this, i);
+            // realtime scheduling can be denied (e.g. without rtprio on Linux), high priority will have to do then
+            if (!workers[i]->startRealtimeThread(juce::Thread::RealtimeOptions {})) {
+                workers[i]->startThread(juce::Thread::Priority::highest);
+            }
+        }
+    }
+
+    RenderThreadPool::~RenderThreadPool() {
+        for (int i = 0; i < numWorkers; i++) {
+            workers[i]->signalThreadShouldExit();
+        }
+        generation.fetch_add(1, std::memory_order_release);
+        generation.notify_all();
+        for (int i = 0; i < numWorkers; i++) {
+            workers[i]->stopThread(1000);
+        }
+    }
+
+    bool RenderThreadPool::run(int numTasks, int maxThreads, TaskFunction newTask, void* newContext) {
+        if (numTasks <= 0) {
+            return true;
+        }
+        auto expected = false;
+        if (!busy.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            return false;
+        }
+
+        task = newTask;
+        context = newContext;
+        numQueues = juce::jlimit(1, juce::jmin(numWorkers + 1, numTasks), maxThreads);
+        if (numQueues == 1) {
+            for (int i = 0; i < numTasks; i++) {
+                task(context, i);
+            }
+            busy.store(false, std::memory_order_release);
+            return true;
+        }
+
+        for (int queue = 0; queue < numQueues; queue++) {
+            queues[queue].next.store(numTasks * queue / numQueues, std::memory_order_relaxed);
+            queues[queue].end = numTasks * (queue + 1) / numQueues;
+        }
+        workersLeft.store(0, std::memory_order_relaxed);
+        auto batch = generation.load(std::memory_order_relaxed) + 1;
+        entry.store((juce::uint64) batch << 32, std::memory_order_release);
+        generation.store(batch, std::memory_order_release);
+        generation.notify_all();
+
+        participate(0);
+
+        // every task is claimed now, wait for the workers that are still busy with theirs
+        auto joined = (int)(entry.fetch_or(closedFlag, std::memory_order_acq_rel) & (closedFlag - 1));
+        while (workersLeft.load(std::memory_order_acquire) != joined) {
+            juce::Thread::yield();
+        }
+
+        busy.store(false, std::memory_order_release);
+        return true;
+    }
+
+    void RenderThreadPool::participate(int queue) {
+        // own slice first, then steal from the others
+        for (int i = 0; i < numQueues; i++) {
+            while (runNextTask((queue + i) % numQueues)) {}
+        }
+    }
+
+    bool RenderThreadPool::runNextTask(int queue) {
+        auto next = queues[queue].next.fetch_add(1, std::memory_order_relaxed);
+        if (next >= queues[queue].end) {
+            return false;
+        }
+        task(context, next);
+        return true;
+    }
+} // namespace lsp
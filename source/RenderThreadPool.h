@@ -0,0 +1,71 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <atomic>
+
+namespace lsp {
+    // A few real-time priority worker threads that help the audio thread through a batch of
+    // independent tasks. Every participant starts on its own slice of the tasks and steals from
+    // the others once its slice is done. The caller always takes part, so a batch finishes even
+    // if no worker wakes up in time. Waking and joining only uses atomics (futex backed
+    // wait/notify), so run() never locks or allocates.
+    // One pool is shared by all plugin instances (see SharedResources), it runs one batch at a
+    // time and run() returns false if another instance is using it.
+    class RenderThreadPool {
+        public:
+        RenderThreadPool();
+        ~RenderThreadPool();
+
+        using TaskFunction = void (*)(void* context, int task);
+
+        // runs task(context, i) for every i in [0, numTasks) on up to maxThreads threads
+        // (the calling one included), returns once all tasks are done. Returns false without
+        // running anything if the pool is busy
+        bool run(int numTasks, int maxThreads, TaskFunction task, void* context);
+
+        template <typename Callable>
+        bool run(int numTasks, int maxThreads, Callable& callable) {
+            return run(numTasks, maxThreads, [](void* context, int task) {
+                (*static_cast<Callable*>(context))(task);
+            }, &callable);
+        }
+
+        // worker threads plus the calling thread
+        int getMaxThreads() const { return numWorkers + 1; }
+
+        static constexpr int maxWorkers = 15;
+
+        private:
+        class Worker;
+
+        // runs tasks until every queue is drained, starting with the given one
+        void participate(int queue);
+        bool runNextTask(int queue);
+
+        // one slice of the task range per participant, claimed front to back with fetch_add
+        struct alignas(64) TaskQueue {
+            std::atomic<int> next { 0 };
+            int end = 0;
+        };
+        TaskQueue queues[maxWorkers + 1];
+
+        // current batch, only valid between the generation bump and the caller closing it
+        TaskFunction task = nullptr;
+        void* context = nullptr;
+        int numQueues = 0;
+
+        // bumped for every batch, the workers wait on it
+        std::atomic<juce::uint32> generation { 0 };
+        // generation in the upper half, number of workers that joined it in the lower half
+        // and closedFlag once the caller doesn't accept any more workers
+        std::atomic<juce::uint64> entry { 0 };
+        std::atomic<int> workersLeft { 0 };
+        static constexpr juce::uint64 closedFlag = juce::uint64 (1) << 31;
+
+        std::atomic<bool> busy { false };
+        int numWorkers = 0;
+        std::unique_ptr<Worker> workers[maxWorkers];
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RenderThreadPool)
+    };
+} // namespace lsp
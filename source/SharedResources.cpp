@@ -1,7 +0,0 @@
- #include "SharedResources.h"
- 
- namespace lsp {
-
-    juce::Random SharedResources::random = {};
-
-}
\ No newline at end of file
@@ -1,8 +1,12 @@
+#pragma once
+
 #include <juce_core/juce_core.h>
+#include "RenderThreadPool.h"
 
 namespace lsp {
     class SharedResources{
         public:
-        static juce::Random random;
+        // the worker threads exist as long as at least one plugin instance holds one of these
+        using RenderThreads = juce::SharedResourcePointer<RenderThreadPool>;
     };
-}
\ No newline at end of file
+}
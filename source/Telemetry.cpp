@@ -0,0 +1,91 @@
+#include "Telemetry.h"
+
+namespace lsp {
+    void Telemetry::push(const BlockStats& stats) {
+        add(totalSpawned, (juce::uint64)stats.spawned);
+        add(totalStolen, (juce::uint64)stats.stolen);
+        add(totalCulled, (juce::uint64)stats.culled);
+        add(totalPrerendered, (juce::uint64)stats.prerendered);
+        add(totalPrerenderMisses, (juce::uint64)stats.prerenderMisses);
+        add(totalLoad, (double)stats.load);
+        activeGrains.store(stats.activeGrains, std::memory_order_relaxed);
+        maxGrains.store(stats.maxGrains, std::memory_order_relaxed);
+        renderSeconds.store(stats.renderSeconds, std::memory_order_relaxed);
+        load.store(stats.load, std::memory_order_relaxed);
+        feedbackLevel.store(stats.feedbackLevel, std::memory_order_relaxed);
+        sleeping.store(stats.sleeping, std::memory_order_relaxed);
+        // a snapshot resets it between the load and the exchange, the block is still counted
+        auto peak = peakLoad.load(std::memory_order_relaxed);
+        while (stats.load > peak && !peakLoad.compare_exchange_weak(peak, stats.load, std::memory_order_relaxed)) {
+        }
+        // everything above is published with the block count
+        numBlocks.store(numBlocks.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+
+        const auto scope = fifo.write(1);
+        if (scope.blockSize1 + scope.blockSize2 == 0) {
+            // nobody reads the history, the snapshot doesn't depend on it
+            add(numDropped, (juce::uint64)1);
+            return;
+        }
+        blocks[(size_t)(scope.blockSize1 > 0 ? scope.startIndex1 : scope.startIndex2)] = stats;
+    }
+
+    Telemetry::Snapshot Telemetry::getSnapshot() {
+        const juce::ScopedLock lock(readerLock);
+        Snapshot snapshot;
+        snapshot.numBlocks = numBlocks.load(std::memory_order_acquire);
+        snapshot.numDropped = numDropped.load(std::memory_order_relaxed);
+        snapshot.totalSpawned = totalSpawned.load(std::memory_order_relaxed);
+        snapshot.totalStolen = totalStolen.load(std::memory_order_relaxed);
+        snapshot.totalCulled = totalCulled.load(std::memory_order_relaxed);
+        snapshot.totalPrerendered = totalPrerendered.load(std::memory_order_relaxed);
+        snapshot.totalPrerenderMisses = totalPrerenderMisses.load(std::memory_order_relaxed);
+        snapshot.activeGrains = activeGrains.load(std::memory_order_relaxed);
+        snapshot.maxGrains = maxGrains.load(std::memory_order_relaxed);
+        snapshot.renderSeconds = renderSeconds.load(std::memory_order_relaxed);
+        snapshot.load = load.load(std::memory_order_relaxed);
+        snapshot.feedbackLevel = feedbackLevel.load(std::memory_order_relaxed);
+        snapshot.sleeping = sleeping.load(std::memory_order_relaxed);
+
+        auto currentTotalLoad = totalLoad.load(std::memory_order_relaxed);
+        auto peak = peakLoad.exchange(0.0f, std::memory_order_relaxed);
+        if (snapshot.numBlocks > previousNumBlocks) {
+            snapshot.peakLoad = peak;
+            snapshot.averageLoad = (float)((currentTotalLoad - previousTotalLoad) / (double)(snapshot.numBlocks - previousNumBlocks));
+        } else {
+            // nothing new, the meters hold the last block's values
+            snapshot.peakLoad = snapshot.load;
+            snapshot.averageLoad = snapshot.load;
+        }
+        previousNumBlocks = snapshot.numBlocks;
+        previousTotalLoad = currentTotalLoad;
+        return snapshot;
+    }
+
+    int Telemetry::readHistory(BlockStats* destination, int maxBlocks) {
+        const juce::ScopedLock lock(readerLock);
+        const auto scope = fifo.read(juce::jmin(maxBlocks, fifo.getNumReady()));
+        std::copy_n(blocks.begin() + scope.startIndex1, scope.blockSize1, destination);
+        std::copy_n(blocks.begin() + scope.startIndex2, scope.blockSize2, destination + scope.blockSize1);
+        return scope.blockSize1 + scope.blockSize2;
+    }
+
+    void Telemetry::reset() {
+        const juce::ScopedLock lock(readerLock);
+        // reading everything is the consumer's way of emptying the FIFO
+        fifo.read(fifo.getNumReady());
+        for (auto* total : { &numBlocks, &numDropped, &totalSpawned, &totalStolen, &totalCulled, &totalPrerendered, &totalPrerenderMisses }) {
+            total->store(0, std::memory_order_relaxed);
+        }
+        totalLoad.store(0.0, std::memory_order_relaxed);
+        activeGrains.store(0, std::memory_order_relaxed);
+        maxGrains.store(0, std::memory_order_relaxed);
+        renderSeconds.store(0.0f, std::memory_order_relaxed);
+        load.store(0.0f, std::memory_order_relaxed);
+        feedbackLevel.store(0.0f, std::memory_order_relaxed);
+        sleeping.store(false, std::memory_order_relaxed);
+        peakLoad.store(0.0f, std::memory_order_relaxed);
+        previousNumBlocks = 0;
+        previousTotalLoad = 0.0;
+    }
+} // namespace lsp
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+namespace lsp {
+    // What the engine did during one processBlock call
+    struct BlockStats {
+        // absolute time of the block's first sample
+        juce::int64 sampleTime = 0;
+        int numSamples = 0;
+        // grains playing at the end of the block, and the limit set by the maxGrains parameter
+        int activeGrains = 0;
+        int maxGrains = 0;
+        // grains that started playing, that replaced a playing grain, and spawns that never
+        // became a grain (dropped by the CPU governor or because the scheduler was full)
+        int spawned = 0;
+        int stolen = 0;
+        int culled = 0;
+        // grains that played from a background render, and ones whose render wasn't done in time
+        int prerendered = 0;
+        int prerenderMisses = 0;
+        // wall clock time of the block, and that relative to the block's duration
+        float renderSeconds = 0.0f;
+        float load = 0.0f;
+        // peak of what was fed back into the delay line
+        float feedbackLevel = 0.0f;
+        // the processor was asleep at the end of the block
+        bool sleeping = false;
+    };
+
+    // Publishes BlockStats from the audio thread to any number of readers.
+    // The running totals and the latest values live in atomics the audio thread updates with
+    // plain stores, so getSnapshot() is current however long nobody looked. The blocks themselves
+    // also go into a preallocated single producer, single consumer FIFO for readers that want the
+    // per block history. The audio thread never waits on it and drops the block if it's full.
+    // Readers (the editor, tests, tools) take a lock only they use, so from the FIFO's point of
+    // view there is only ever one consumer.
+    class Telemetry {
+        public:
+        // running totals and the latest values of the blocks published so far
+        struct Snapshot {
+            juce::uint64 numBlocks = 0;
+            // blocks that didn't fit into the history
+            juce::uint64 numDropped = 0;
+            juce::uint64 totalSpawned = 0;
+            juce::uint64 totalStolen = 0;
+            juce::uint64 totalCulled = 0;
+            juce::uint64 totalPrerendered = 0;
+            juce::uint64 totalPrerenderMisses = 0;
+            int activeGrains = 0;
+            int maxGrains = 0;
+            float renderSeconds = 0.0f;
+            float load = 0.0f;
+            // highest and mean load of the blocks since the previous snapshot
+            float peakLoad = 0.0f;
+            float averageLoad = 0.0f;
+            float feedbackLevel = 0.0f;
+            bool sleeping = false;
+        };
+
+        static constexpr int capacity = 1024;
+
+        Telemetry() = default;
+        ~Telemetry() = default;
+
+        // audio thread only, never blocks
+        void push(const BlockStats& stats);
+
+        // any thread but the audio thread
+        Snapshot getSnapshot();
+        // Moves up to maxBlocks of the oldest blocks in the history into destination and returns
+        // how many. The history holds capacity blocks, poll it at least that often to see them all
+        int readHistory(BlockStats* destination, int maxBlocks);
+        // forgets everything, including blocks that are still in the FIFO, not while the audio thread pushes
+        void reset();
+
+        private:
+        // only the audio thread writes these
+        template <typename T>
+        static void add(std::atomic<T>& total, T value) { total.store(total.load(std::memory_order_relaxed) + value, std::memory_order_relaxed); }
+
+        std::atomic<juce::uint64> numBlocks { 0 };
+        std::atomic<juce::uint64> numDropped { 0 };
+        std::atomic<juce::uint64> totalSpawned { 0 };
+        std::atomic<juce::uint64> totalStolen { 0 };
+        std::atomic<juce::uint64> totalCulled { 0 };
+        std::atomic<juce::uint64> totalPrerendered { 0 };
+        std::atomic<juce::uint64> totalPrerenderMisses { 0 };
+        std::atomic<double> totalLoad { 0.0 };
+        std::atomic<int> activeGrains { 0 };
+        std::atomic<int> maxGrains { 0 };
+        std::atomic<float> renderSeconds { 0.0f };
+        std::atomic<float> load { 0.0f };
+        std::atomic<float> feedbackLevel { 0.0f };
+        std::atomic<bool> sleeping { false };
+        // raised by the audio thread, taken back to 0 by every snapshot
+        std::atomic<float> peakLoad { 0.0f };
+
+        // an AbstractFifo always keeps one slot empty
+        juce::AbstractFifo fifo { capacity + 1 };
+        std::array<BlockStats, capacity + 1> blocks {};
+
+        juce::CriticalSection readerLock;
+        // where the previous snapshot left off, for the load since then
+        juce::uint64 previousNumBlocks = 0;
+        double previousTotalLoad = 0.0;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Telemetry)
+    };
+} // namespace lsp
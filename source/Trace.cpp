@@ -0,0 +1,90 @@
+#include "Trace.h"
+
+namespace lsp {
+    Trace::Trace(int capacity) {
+    #if LSP_TRACING
+        events.resize((size_t)capacity);
+    #else
+        juce::ignoreUnused(capacity);
+    #endif
+    }
+
+    void Trace::clear() {
+        numAdded.store(0, std::memory_order_relaxed);
+    }
+
+    void Trace::add(const Event& event) {
+        if (events.empty()) {
+            return;
+        }
+        auto index = numAdded.load(std::memory_order_relaxed);
+        events[(size_t)(index % events.size())] = event;
+        numAdded.store(index + 1, std::memory_order_release);
+    }
+
+    void Trace::addSpan(const char* name, juce::int64 startTicks, juce::int64 endTicks, double value) {
+        add({ name, 'X', startTicks, endTicks - startTicks, 0, value });
+    }
+
+    void Trace::addInstant(const char* name, double value) {
+        add({ name, 'i', juce::Time::getHighResolutionTicks(), 0, 0, value });
+    }
+
+    void Trace::beginAsync(const char* name, juce::uint64 id, double value) {
+        add({ name, 'b', juce::Time::getHighResolutionTicks(), 0, id, value });
+    }
+
+    void Trace::endAsync(const char* name, juce::uint64 id) {
+        add({ name, 'e', juce::Time::getHighResolutionTicks(), 0, id, 0.0 });
+    }
+
+    int Trace::getNumEvents() const {
+        return (int)juce::jmin(numAdded.load(std::memory_order_acquire), (juce::uint64)events.size());
+    }
+
+    const Trace::Event& Trace::getEvent(int index) const {
+        auto total = numAdded.load(std::memory_order_acquire);
+        auto first = total - (juce::uint64)getNumEvents();
+        return events[(size_t)((first + (juce::uint64)index) % events.size())];
+    }
+
+    void Trace::writeChromeTrace(juce::OutputStream& stream, const juce::String& processName) const {
+        // timestamps are in microseconds, relative to the earliest start in the buffer
+        // (spans are added when they end, so that isn't necessarily the first event)
+        auto numEvents = getNumEvents();
+        auto origin = numEvents > 0 ? getEvent(0).startTicks : 0;
+        for (int i = 1; i < numEvents; i++) {
+            origin = juce::jmin(origin, getEvent(i).startTicks);
+        }
+        auto toMicroseconds = [] (juce::int64 ticks) {
+            return juce::Time::highResolutionTicksToSeconds(ticks) * 1.0e6;
+        };
+
+        stream << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+        stream << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":"
+               << juce::JSON::toString(processName) << "}}";
+        for (int i = 0; i < numEvents; i++) {
+            const auto& event = getEvent(i);
+            stream << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"" << juce::String::charToString(event.phase)
+                   << "\",\"pid\":1,\"tid\":1,\"ts\":" << juce::String(toMicroseconds(event.startTicks - origin), 3);
+            switch (event.phase) {
+                case 'X': stream << ",\"dur\":" << juce::String(toMicroseconds(event.durationTicks), 3); break;
+                case 'i': stream << ",\"s\":\"t\""; break;
+                default: stream << ",\"cat\":\"grain\",\"id\":" << juce::String(event.id); break;
+            }
+            stream << ",\"args\":{\"value\":" << juce::String(event.value) << "}}";
+        }
+        stream << "\n]}\n";
+    }
+
+    bool Trace::writeChromeTrace(const juce::File& file, const juce::String& processName) const {
+        file.deleteFile();
+        juce::FileOutputStream stream(file);
+        if (!stream.openedOk()) {
+            return false;
+        }
+        writeChromeTrace(stream, processName);
+        stream.flush();
+        return stream.getStatus().wasOk();
+    }
+} // namespace lsp
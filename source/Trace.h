@@ -0,0 +1,98 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+namespace lsp {
+    // Records what the audio thread does into a preallocated ring buffer, so a dropout can be
+    // pinned on the block, the phase and the grains that caused it. The recorder is written from
+    // the audio thread only and overwrites its oldest events once full. Nothing is formatted
+    // until writeChromeTrace(), which produces JSON for chrome://tracing and ui.perfetto.dev.
+    //
+    // Tracing has two switches: targets built with LSP_TRACING=1 (the benchmarks, the tests and
+    // the batch tools) compile the LSP_TRACE_ macros in and allocate the buffer, setEnabled()
+    // turns recording on and off at run time. In the plugin itself the macros compile to nothing.
+    class Trace {
+        public:
+        struct Event {
+            const char* name = nullptr;
+            // Chrome trace phase: 'X' span, 'i' instant, 'b' / 'e' begin and end of an async event
+            char phase = 'X';
+            juce::int64 startTicks = 0;
+            juce::int64 durationTicks = 0;
+            // groups async events (the grain's serial number)
+            juce::uint64 id = 0;
+            // shows up as args.value
+            double value = 0.0;
+        };
+
+        static constexpr int defaultCapacity = 1 << 16;
+
+        explicit Trace(int capacity = defaultCapacity);
+        ~Trace() = default;
+
+        // safe to call from any thread, events in flight may still be recorded
+        void setEnabled(bool shouldBeEnabled) { enabled.store(shouldBeEnabled, std::memory_order_relaxed); }
+        bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+        // only while the audio thread isn't recording
+        void clear();
+
+        // audio thread only, these never allocate or block
+        void addSpan(const char* name, juce::int64 startTicks, juce::int64 endTicks, double value = 0.0);
+        void addInstant(const char* name, double value = 0.0);
+        void beginAsync(const char* name, juce::uint64 id, double value = 0.0);
+        void endAsync(const char* name, juce::uint64 id);
+
+        // events currently in the buffer, oldest first
+        int getNumEvents() const;
+        const Event& getEvent(int index) const;
+
+        // writes the buffer as a Chrome trace event JSON object, only while the audio thread isn't recording
+        void writeChromeTrace(juce::OutputStream& stream, const juce::String& processName) const;
+        bool writeChromeTrace(const juce::File& file, const juce::String& processName) const;
+
+        // records the lifetime of a scope as a span
+        class ScopedSpan {
+            public:
+            ScopedSpan(Trace& trace, const char* name, double value = 0.0)
+                : trace(trace), name(name), value(value),
+                  startTicks(trace.isEnabled() ? juce::Time::getHighResolutionTicks() : 0) {}
+            ~ScopedSpan() {
+                if (startTicks != 0) {
+                    trace.addSpan(name, startTicks, juce::Time::getHighResolutionTicks(), value);
+                }
+            }
+
+            private:
+            Trace& trace;
+            const char* name;
+            double value;
+            juce::int64 startTicks;
+
+            JUCE_DECLARE_NON_COPYABLE (ScopedSpan)
+        };
+
+        private:
+        void add(const Event& event);
+
+        std::vector<Event> events;
+        std::atomic<bool> enabled { false };
+        // total number of events ever added, the next one goes to numAdded % capacity
+        std::atomic<juce::uint64> numAdded { 0 };
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Trace)
+    };
+} // namespace lsp
+
+#if LSP_TRACING
+    #define LSP_TRACE_SPAN(trace, name) const lsp::Trace::ScopedSpan JUCE_JOIN_MACRO (lspTraceSpan, __LINE__) (trace, name)
+    #define LSP_TRACE_SPAN_VALUE(trace, name, value) const lsp::Trace::ScopedSpan JUCE_JOIN_MACRO (lspTraceSpan, __LINE__) (trace, name, value)
+    #define LSP_TRACE_INSTANT(trace, name, value) do { if ((trace).isEnabled()) (trace).addInstant (name, value); } while (false)
+    #define LSP_TRACE_BEGIN_ASYNC(trace, name, id, value) do { if ((trace).isEnabled()) (trace).beginAsync (name, id, value); } while (false)
+    #define LSP_TRACE_END_ASYNC(trace, name, id) do { if ((trace).isEnabled()) (trace).endAsync (name, id); } while (false)
+#else
+    #define LSP_TRACE_SPAN(trace, name)
+    #define LSP_TRACE_SPAN_VALUE(trace, name, value)
+    #define LSP_TRACE_INSTANT(trace, name, value)
+    #define LSP_TRACE_BEGIN_ASYNC(trace, name, id, value)
+    #define LSP_TRACE_END_ASYNC(trace, name, id)
+#endif
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+namespace lsp {
+    // Hands the latest version of a value from one writer thread to one reader thread without
+    // locks or waiting. The writer fills its own buffer and publishes it by swapping it with the
+    // spare one, the reader swaps the spare one with its own whenever something new was published.
+    // Neither side ever sees a buffer the other one is using, versions the reader didn't get to are
+    // simply overwritten.
+    template <typename T>
+    class TripleBuffer {
+        public:
+        TripleBuffer() = default;
+        ~TripleBuffer() = default;
+
+        // writer side
+        T& getWriteBuffer() { return buffers[(size_t)writeIndex]; }
+        void publish() {
+            auto previous = spare.exchange(writeIndex | newDataFlag, std::memory_order_acq_rel);
+            writeIndex = previous & indexMask;
+        }
+
+        // reader side, returns false if nothing was published since the last call
+        bool update() {
+            if ((spare.load(std::memory_order_relaxed) & newDataFlag) == 0) {
+                return false;
+            }
+            auto previous = spare.exchange(readIndex, std::memory_order_acq_rel);
+            readIndex = previous & indexMask;
+            return true;
+        }
+        const T& getReadBuffer() const { return buffers[(size_t)readIndex]; }
+
+        private:
+        static constexpr int indexMask = 3;
+        static constexpr int newDataFlag = 4;
+
+        std::array<T, 3> buffers {};
+        int writeIndex = 0;
+        // index of the buffer nobody is using, plus newDataFlag if the writer put it there
+        std::atomic<int> spare { 1 };
+        int readIndex = 2;
+    };
+} // namespace lsp
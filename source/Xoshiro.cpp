@@ -0,0 +1,68 @@
+#include "Xoshiro.h"
+
+namespace lsp {
+    void Xoshiro::prepare(int batchSize) {
+        auto numRounds = juce::jmax(1, (batchSize + numLanes - 1) / numLanes);
+        buffer.resize((size_t)(numRounds * numLanes));
+        readPosition = 0;
+        numBuffered = 0;
+    }
+
+    void Xoshiro::seed(juce::uint64 seed) {
+        // splitmix64 spreads the seed over all lanes, so neighbouring seeds give unrelated streams
+        for (int lane = 0; lane < numLanes; lane++) {
+            for (int word = 0; word < 4; word += 2) {
+                auto z = (seed += 0x9e3779b97f4a7c15ull);
+                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+                z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+                z = z ^ (z >> 31);
+                state[word][lane] = (juce::uint32)z;
+                state[word + 1][lane] = (juce::uint32)(z >> 32);
+            }
+        }
+        readPosition = 0;
+        numBuffered = 0;
+    }
+
+    void Xoshiro::refill(int num) {
+        jassert(num <= (int)buffer.size()); // call prepare() with a bigger batch!
+        auto unread = numBuffered - readPosition;
+        if (unread >= num) {
+            return;
+        }
+        // keep the unread values in front, so nothing gets skipped
+        std::copy(buffer.begin() + readPosition, buffer.begin() + numBuffered, buffer.begin());
+        auto numRounds = ((int)buffer.size() - unread) / numLanes;
+        generate(buffer.data() + unread, numRounds);
+        readPosition = 0;
+        numBuffered = unread + numRounds * numLanes;
+    }
+
+    void Xoshiro::generate(juce::uint32* destination, int numRounds) {
+        for (int round = 0; round < numRounds; round++) {
+            auto* out = destination + round * numLanes;
+            for (int lane = 0; lane < numLanes; lane++) {
+                out[lane] = state[0][lane] + state[3][lane];
+                auto t = state[1][lane] << 9;
+                state[2][lane] ^= state[0][lane];
+                state[3][lane] ^= state[1][lane];
+                state[1][lane] ^= state[2][lane];
+                state[0][lane] ^= state[3][lane];
+                state[2][lane] ^= t;
+                state[3][lane] = (state[3][lane] << 11) | (state[3][lane] >> 21);
+            }
+        }
+    }
+
+    juce::uint32 Xoshiro::nextInt() {
+        if (readPosition == numBuffered) {
+            refill(1);
+        }
+        return buffer[(size_t)readPosition++];
+    }
+
+    float Xoshiro::nextFloat() {
+        // the top 24 bits are the best ones in xoshiro128+ and fit a float's mantissa exactly
+        return (float)(nextInt() >> 8) * (1.0f / 16777216.0f);
+    }
+} // namespace lsp
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+namespace lsp {
+    // xoshiro128+ random number generator, one per processor.
+    // It runs numLanes independent generators side by side (state stored lane by lane) and hands out
+    // their outputs interleaved. Values are generated a whole batch at a time, and the lane loop
+    // turns into SIMD instructions. The stream only depends on the seed and the number of values
+    // drawn, not on when the batches get refilled, so renders with the same seed are identical
+    // whatever the block size.
+    class Xoshiro {
+        public:
+        static constexpr int numLanes = 8;
+
+        Xoshiro() = default;
+        ~Xoshiro() = default;
+
+        // allocates room for batchSize buffered values (rounded up to a multiple of numLanes)
+        void prepare(int batchSize);
+        // restarts the stream, the same seed always gives the same values
+        void seed(juce::uint64 seed);
+
+        // makes sure at least num values are buffered, so the next num draws don't generate anything
+        void refill(int num);
+
+        juce::uint32 nextInt();
+        // uniform in [0, 1)
+        float nextFloat();
+
+        private:
+        void generate(juce::uint32* destination, int numRounds);
+
+        // s[i][lane] is word i of that lane's state
+        alignas(32) juce::uint32 state[4][numLanes] {};
+        std::vector<juce::uint32> buffer;
+        int readPosition = 0;
+        int numBuffered = 0;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Xoshiro)
+    };
+} // namespace lsp
@@ -0,0 +1,49 @@
+#include <CpuGovernor.h>
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE ("CPU governor", "[governor]")
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 480; // 10 ms
+    lsp::CpuGovernor governor;
+    governor.prepare (sampleRate);
+    governor.setBudget (0.5f);
+
+    // feeds seconds of audio rendered at the given fraction of the deadline
+    auto run = [&] (double seconds, double load) {
+        for (int block = 0; block < (int) (seconds * 100.0); block++)
+            governor.update (load * blockSize / sampleRate, blockSize);
+    };
+
+    SECTION ("stays at full quality within budget")
+    {
+        run (2.0, 0.4);
+        REQUIRE (governor.getLevel() == lsp::CpuGovernor::full);
+        REQUIRE (governor.shouldSpawn());
+        REQUIRE (governor.limitRate (1.5f) == 1.5f);
+        REQUIRE (governor.limitInterpolation (lsp::InterpolationType::Sinc) == lsp::InterpolationType::Sinc);
+    }
+
+    SECTION ("degrades step by step under load and recovers")
+    {
+        run (0.5, 0.9);
+        auto level = governor.getLevel();
+        REQUIRE (level > lsp::CpuGovernor::full);
+        REQUIRE (governor.limitInterpolation (lsp::InterpolationType::Sinc) == lsp::InterpolationType::Linear);
+
+        run (2.0, 0.9);
+        REQUIRE (governor.getLevel() == lsp::CpuGovernor::quarterDensity);
+        REQUIRE (governor.limitRate (1.5f) == 1.0f);
+        auto spawned = 0;
+        for (int i = 0; i < 8; i++)
+            spawned += governor.shouldSpawn() ? 1 : 0;
+        REQUIRE (spawned == 2);
+
+        // the hysteresis band holds the level
+        run (5.0, 0.4);
+        REQUIRE (governor.getLevel() == lsp::CpuGovernor::quarterDensity);
+
+        run (10.0, 0.1);
+        REQUIRE (governor.getLevel() == lsp::CpuGovernor::full);
+    }
+}
@@ -0,0 +1,61 @@
+#include <DelayLine.h>
+#include <catch2/catch_approx.hpp>
+#include <catch2/generators/catch_generators.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+namespace
+{
+    float readSample (const lsp::DelayLine& delayLine, int frame, int channel)
+    {
+        auto index = (frame & delayLine.getMask()) * delayLine.getNumChannels() + channel;
+        switch (delayLine.getPrecision())
+        {
+            case lsp::DelayPrecision::Fixed16:
+                return lsp::storage::Fixed16::decode (delayLine.getData<lsp::storage::Fixed16>()[index]);
+            case lsp::DelayPrecision::BFloat16:
+                return lsp::storage::BFloat16::decode (delayLine.getData<lsp::storage::BFloat16>()[index]);
+            case lsp::DelayPrecision::Float64:
+                return (float) delayLine.getData<lsp::storage::Float64>()[index];
+            default:
+                return delayLine.getData<lsp::storage::Float32>()[index];
+        }
+    }
+}
+
+TEST_CASE ("Delay line", "[delay]")
+{
+    auto precision = GENERATE (lsp::DelayPrecision::Float32, lsp::DelayPrecision::Fixed16, lsp::DelayPrecision::BFloat16, lsp::DelayPrecision::Float64);
+    lsp::DelayLine delayLine;
+    delayLine.prepare (2, 100, precision);
+
+    // a ramp through the whole range the line has headroom for
+    auto source = [] (int channel, int i) { return std::sin ((float) i * 0.1f) * 3.5f * (channel == 0 ? 1.0f : -0.5f); };
+    constexpr int numFrames = 300;
+    juce::AudioBuffer<float> input (2, numFrames);
+    for (int channel = 0; channel < 2; channel++)
+        for (int i = 0; i < numFrames; i++)
+            input.setSample (channel, i, source (channel, i));
+
+    SECTION ("the length is rounded up to a power of two")
+    {
+        REQUIRE (delayLine.getLength() == 128);
+        auto bytesPerSample = precision == lsp::DelayPrecision::Float64 ? 8 : precision == lsp::DelayPrecision::Float32 ? 4 : 2;
+        REQUIRE (delayLine.getSizeInBytes() == (size_t) 128 * 2 * (size_t) bytesPerSample);
+    }
+
+    SECTION ("writes wrap around and keep the newest frames")
+    {
+        // uneven pushes, so some of them straddle the end of the ring
+        for (int start = 0; start < numFrames; start += 37)
+            delayLine.push (input.getArrayOfReadPointers(), start, juce::jmin (37, numFrames - start));
+        REQUIRE (delayLine.getWritePosition() == (numFrames & delayLine.getMask()));
+
+        // bfloat16 keeps 8 bits of mantissa, fixed point has a constant step over its headroom
+        auto tolerance = precision == lsp::DelayPrecision::Float32 || precision == lsp::DelayPrecision::Float64 ? 0.0f
+            : precision == lsp::DelayPrecision::Fixed16 ? lsp::storage::Fixed16::headroom / 32767.0f
+            : 3.5f / 256.0f;
+        for (int i = numFrames - delayLine.getLength(); i < numFrames; i++)
+            for (int channel = 0; channel < 2; channel++)
+                REQUIRE (readSample (delayLine, i, channel) == Catch::Approx (source (channel, i)).margin (tolerance));
+    }
+}
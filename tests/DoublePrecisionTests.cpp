@@ -0,0 +1,68 @@
+#include "helpers/realtime_checker.h"
+#include "helpers/test_helpers.h"
+#include <catch2/catch_test_macros.hpp>
+
+namespace
+{
+    // a second of seeded grains over noise, in the given precision
+    template <typename SampleType>
+    juce::AudioBuffer<SampleType> render (bool checkRealtimeSafety = false)
+    {
+        PluginProcessor plugin;
+        plugin.setNonRealtime (true);
+        plugin.setProcessingPrecision (std::is_same_v<SampleType, double> ? juce::AudioProcessor::doublePrecision : juce::AudioProcessor::singlePrecision);
+        setParameter (plugin, "seed", 3.0f);
+        setParameter (plugin, "grainRate", 100.0f);
+        setParameter (plugin, "delayTime", 0.05f);
+        setParameter (plugin, "feedback", 0.8f);
+        setParameter (plugin, "parallelRender", 1.0f);
+        plugin.prepareToPlay (48000.0, 256);
+
+        juce::AudioBuffer<SampleType> output (2, 48000);
+        juce::AudioBuffer<SampleType> block (2, 256);
+        juce::MidiBuffer midi;
+        juce::Random noise (1);
+        auto renderBlocks = [&] (int firstSample, int endSample) {
+            for (int start = firstSample; start + 256 <= endSample; start += 256)
+            {
+                for (int channel = 0; channel < 2; channel++)
+                    for (int i = 0; i < 256; i++)
+                        block.setSample (channel, i, (SampleType) (noise.nextFloat() * 2.0f - 1.0f));
+                plugin.processBlock (block, midi);
+                for (int channel = 0; channel < 2; channel++)
+                    output.copyFrom (channel, start, block, channel, 0, 256);
+            }
+        };
+        // settle once so the first envelope tables etc. exist
+        renderBlocks (0, 1024);
+        if (checkRealtimeSafety)
+            REQUIRE_THAT ([&] { renderBlocks (1024, output.getNumSamples()); }, lsp::test::IsRealtimeSafe());
+        else
+            renderBlocks (1024, output.getNumSamples());
+        return output;
+    }
+}
+
+TEST_CASE ("Double precision processing", "[precision]")
+{
+    auto gui = juce::ScopedJuceInitialiser_GUI {};
+    PluginProcessor plugin;
+    REQUIRE (plugin.supportsDoublePrecisionProcessing());
+
+    SECTION ("renders the same grains as single precision")
+    {
+        auto single = render<float>();
+        auto full = render<double>();
+        auto maxError = 0.0;
+        for (int channel = 0; channel < 2; channel++)
+            for (int i = 0; i < single.getNumSamples(); i++)
+                maxError = juce::jmax (maxError, std::abs ((double) single.getSample (channel, i) - full.getSample (channel, i)));
+        REQUIRE (full.getMagnitude (0, full.getNumSamples()) > 0.1);
+        REQUIRE (maxError < 1.0e-3);
+    }
+
+    SECTION ("is real-time safe")
+    {
+        render<double> (true);
+    }
+}
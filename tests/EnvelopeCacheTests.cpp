@@ -0,0 +1,82 @@
+#include <EnvelopeCache.h>
+#include <catch2/catch_approx.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE ("Envelope cache", "[envelopes]")
+{
+    lsp::EnvelopeCache cache;
+    cache.prepare (1024);
+
+    lsp::EnvelopeShape shape { lsp::WindowShape::ADSR, 0.003f, 0.01f, 1.0f, 0.003f, 44100 };
+
+    SECTION ("identical shapes share one table")
+    {
+        auto& a = cache.getTable (shape);
+        auto& b = cache.getTable (shape);
+        REQUIRE (&a == &b);
+        REQUIRE (a.lengthInSamples == shape.getLengthInSamples());
+    }
+
+    SECTION ("tables in use are not overwritten")
+    {
+        auto& busy = cache.getTable (shape);
+        busy.users = 1;
+
+        for (int i = 1; i < lsp::EnvelopeCache::numSlots * 2; i++)
+        {
+            auto other = shape;
+            other.sustain = (float) i / (float) (lsp::EnvelopeCache::numSlots * 2);
+            REQUIRE (&cache.getTable (other) != &busy);
+        }
+        REQUIRE (busy.shape == shape);
+    }
+
+    SECTION ("the last table is handed out while every slot is in use")
+    {
+        std::vector<lsp::EnvelopeTable*> busy;
+        std::vector<std::vector<float>> contents;
+        for (int i = 0; i < lsp::EnvelopeCache::numSlots; i++)
+        {
+            auto held = shape;
+            held.attack = 0.001f * (float) (i + 1);
+            auto& table = cache.getTable (held);
+            table.users = 1;
+            busy.push_back (&table);
+            contents.emplace_back (table.data(), table.data() + table.lengthInSamples);
+        }
+
+        auto other = shape;
+        other.attack = 0.02f;
+        REQUIRE (&cache.getTable (other) == busy.back());
+        for (int i = 0; i < lsp::EnvelopeCache::numSlots; i++)
+        {
+            REQUIRE (busy[(size_t) i]->lengthInSamples == (int) contents[(size_t) i].size());
+            REQUIRE (std::equal (contents[(size_t) i].begin(), contents[(size_t) i].end(), busy[(size_t) i]->data()));
+        }
+
+        // and the new shape gets rendered as soon as a slot frees up
+        busy.front()->users = 0;
+        auto& rendered = cache.getTable (other);
+        REQUIRE (&rendered == busy.front());
+        REQUIRE (rendered.shape == other);
+    }
+
+    SECTION ("ADSR tables end silent")
+    {
+        auto& table = cache.getTable (shape);
+        REQUIRE (table.data()[table.lengthInSamples - 1] == Catch::Approx (0.0f).margin (0.01f));
+    }
+
+    SECTION ("windows are symmetric and peak in the middle")
+    {
+        for (auto window : { lsp::WindowShape::Hann, lsp::WindowShape::Tukey, lsp::WindowShape::Gaussian })
+        {
+            shape.window = window;
+            auto& table = cache.getTable (shape);
+            auto last = table.lengthInSamples - 1;
+
+            REQUIRE (table.data()[0] == Catch::Approx (table.data()[last]));
+            REQUIRE (table.data()[last / 2] == Catch::Approx (1.0f).margin (0.01f));
+        }
+    }
+}
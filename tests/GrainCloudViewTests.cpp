@@ -0,0 +1,62 @@
+#include <GrainCloudView.h>
+#include <catch2/catch_test_macros.hpp>
+
+namespace
+{
+    // lets the view's frame timer fire once, if it's still running
+    void runFrameTimer()
+    {
+        juce::Thread::sleep (3 * 1000 / GrainCloudView::frameRate);
+        juce::Timer::callPendingTimersSynchronously();
+    }
+}
+
+TEST_CASE ("Grain cloud view only refreshes while it's showing", "[ui]")
+{
+    auto gui = juce::ScopedJuceInitialiser_GUI {};
+    PluginProcessor plugin;
+    GrainCloudView view (plugin);
+    juce::Component window;
+    window.addAndMakeVisible (view);
+    window.setBounds (0, 0, 400, 200);
+    view.setBounds (window.getLocalBounds());
+
+    REQUIRE_FALSE (view.isRefreshing());
+    window.addToDesktop (juce::ComponentPeer::windowHasTitleBar);
+    window.setVisible (true);
+    REQUIRE (view.isShowing());
+    REQUIRE (view.isRefreshing());
+    REQUIRE (plugin.isGrainCloudVisible());
+
+    SECTION ("stops when the processor stops publishing, and starts again when shown")
+    {
+        plugin.setGrainCloudVisible (false);
+        runFrameTimer();
+        REQUIRE_FALSE (view.isRefreshing());
+
+        view.setVisible (false);
+        view.setVisible (true);
+        REQUIRE (view.isRefreshing());
+        REQUIRE (plugin.isGrainCloudVisible());
+    }
+
+    SECTION ("stops while the window is minimised")
+    {
+        auto* peer = window.getPeer();
+        REQUIRE (peer != nullptr);
+        peer->setMinimised (true);
+        if (!peer->isMinimised())
+            SKIP ("there's no window manager to minimise the window");
+
+        runFrameTimer();
+        REQUIRE_FALSE (view.isRefreshing());
+        REQUIRE_FALSE (plugin.isGrainCloudVisible());
+    }
+
+    SECTION ("stops when hidden")
+    {
+        window.setVisible (false);
+        REQUIRE_FALSE (view.isRefreshing());
+        REQUIRE_FALSE (plugin.isGrainCloudVisible());
+    }
+}
@@ -0,0 +1,142 @@
+#include <GrainMixer.h>
+#include <catch2/catch_approx.hpp>
+#include <catch2/generators/catch_generators.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+namespace
+{
+    // what the mixer should produce at one sample of an interpolated grain, tap by tap
+    template <typename Interpolator>
+    float interpolate (std::function<float (int)> read, double position)
+    {
+        auto index = (int) position;
+        float coefficients[Interpolator::numTaps];
+        Interpolator::getCoefficients ((float) (position - index), coefficients);
+        auto result = 0.0f;
+        for (int tap = 0; tap < Interpolator::numTaps; tap++)
+            result += coefficients[tap] * read (index - Interpolator::before + tap);
+        return result;
+    }
+
+    float interpolate (lsp::InterpolationType type, std::function<float (int)> read, double position)
+    {
+        switch (type)
+        {
+            case lsp::InterpolationType::Linear:
+                return interpolate<lsp::interpolation::Linear> (read, position);
+            case lsp::InterpolationType::Cubic:
+                return interpolate<lsp::interpolation::Cubic> (read, position);
+            case lsp::InterpolationType::Lagrange:
+                return interpolate<lsp::interpolation::Lagrange> (read, position);
+            case lsp::InterpolationType::Sinc:
+                return interpolate<lsp::interpolation::Sinc> (read, position);
+        }
+        return 0.0f;
+    }
+}
+
+TEST_CASE ("Grain mixer", "[grains]")
+{
+    constexpr int historyLength = 1024;
+    auto numChannels = GENERATE (1, 2, 5, 6);
+    lsp::DelayLine delayLine;
+    delayLine.prepare (numChannels, historyLength);
+    // a different ramp per channel, so a sample's value tells us where it was read from
+    auto source = [] (int channel, int i) { return (float) i * 0.001f + (float) channel; };
+    juce::AudioBuffer<float> input (numChannels, historyLength);
+    for (int channel = 0; channel < numChannels; channel++)
+        for (int i = 0; i < historyLength; i++)
+            input.setSample (channel, i, source (channel, i));
+    delayLine.push (input.getArrayOfReadPointers(), 0, historyLength);
+    const juce::int64 now = historyLength;
+
+    lsp::EnvelopeCache envelopes;
+    envelopes.prepare (512);
+    auto& envelope = envelopes.getTable ({ lsp::WindowShape::Hann, 0.002f, 0.002f, 1.0f, 0.002f, 44100 });
+
+    lsp::GrainMixer mixer;
+    mixer.prepare (4, numChannels);
+    juce::AudioBuffer<float> output (numChannels, 128);
+    output.clear();
+
+    SECTION ("forward and reversed grains read their window in the right direction")
+    {
+        lsp::Grain forward (now, 100, envelope, false);
+        lsp::Grain reversed (now, 100, envelope, true);
+        lsp::Grain* grains[] = { &forward, &reversed };
+        mixer.process (grains, 1, output, 0, 128, delayLine, now);
+
+        for (int channel = 0; channel < numChannels; channel++)
+            for (int i = 0; i < 128; i++)
+                REQUIRE (output.getSample (channel, i) == Catch::Approx (envelope.data()[i] * source (channel, 100 + i)).margin (1.0e-5f));
+
+        output.clear();
+        mixer.process (grains + 1, 1, output, 0, 128, delayLine, now);
+        auto last = reversed.lengthInSamples - 1;
+        for (int channel = 0; channel < numChannels; channel++)
+            for (int i = 0; i < 128; i++)
+                REQUIRE (output.getSample (channel, i) == Catch::Approx (envelope.data()[i] * source (channel, 100 + last - i)).margin (1.0e-5f));
+    }
+
+    SECTION ("grains read across the end of the ring")
+    {
+        // the line is a power of two long, so the next frames overwrite it from index 0 again
+        delayLine.push (input.getArrayOfReadPointers(), 0, 256);
+        auto later = now + 256;
+        auto value = [&] (int channel, int time) { return source (channel, time < historyLength ? time : time - historyLength); };
+
+        lsp::Grain grain (later, historyLength - 64, envelope, false);
+        lsp::Grain* grains[] = { &grain };
+        mixer.process (grains, 1, output, 0, 128, delayLine, later);
+
+        for (int channel = 0; channel < numChannels; channel++)
+            for (int i = 0; i < 128; i++)
+                REQUIRE (output.getSample (channel, i) == Catch::Approx (envelope.data()[i] * value (channel, historyLength - 64 + i)).margin (1.0e-5f));
+    }
+
+    SECTION ("interpolated grains match a sample by sample reference render")
+    {
+        auto type = GENERATE (lsp::InterpolationType::Linear, lsp::InterpolationType::Cubic, lsp::InterpolationType::Lagrange, lsp::InterpolationType::Sinc);
+        auto reversed = GENERATE (false, true);
+        constexpr auto rate = 1.37f;
+        constexpr juce::int64 sourceStart = 100;
+        lsp::Grain grain (now, sourceStart, envelope, reversed, rate, type);
+        lsp::Grain* grains[] = { &grain };
+        REQUIRE (sourceStart + grain.getSourceLength() < now);
+
+        // whole blocks, so the grain runs across several tiles and process() calls
+        juce::AudioBuffer<float> rendered (numChannels, grain.lengthInSamples);
+        for (int start = 0; !grain.isFinished(); start += output.getNumSamples())
+        {
+            output.clear();
+            mixer.process (grains, 1, output, 0, output.getNumSamples(), delayLine, now);
+            auto num = juce::jmin (output.getNumSamples(), grain.lengthInSamples - start);
+            for (int channel = 0; channel < numChannels; channel++)
+                rendered.copyFrom (channel, start, output, channel, 0, num);
+        }
+
+        auto lastPosition = (double) (grain.lengthInSamples - 1) * rate;
+        for (int channel = 0; channel < numChannels; channel++)
+        {
+            auto read = [&] (int i) { return source (channel, (int) sourceStart + i); };
+            for (int i = 0; i < grain.lengthInSamples; i++)
+            {
+                auto position = (double) i * rate;
+                auto expected = envelope.data()[i] * interpolate (type, read, reversed ? lastPosition - position : position);
+                INFO ("channel " << channel << ", sample " << i);
+                REQUIRE (rendered.getSample (channel, i) == Catch::Approx (expected).margin (1.0e-5f));
+            }
+        }
+    }
+
+    SECTION ("grains advance and stop at their length")
+    {
+        lsp::Grain grain (now, 100, envelope, false, 1.5f, lsp::InterpolationType::Sinc);
+        lsp::Grain* grains[] = { &grain };
+        while (!grain.isFinished())
+            mixer.process (grains, 1, output, 0, 128, delayLine, now);
+
+        REQUIRE (grain.progress == grain.lengthInSamples);
+        REQUIRE (grain.envelopeLevel == envelope.data()[grain.lengthInSamples - 1]);
+    }
+}
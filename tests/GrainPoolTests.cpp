@@ -0,0 +1,115 @@
+#include <GrainPool.h>
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE ("Grain pool", "[grains]")
+{
+    lsp::GrainPool pool;
+    pool.prepare (8);
+
+    lsp::EnvelopeCache envelopes;
+    envelopes.prepare (256);
+    auto& envelope = envelopes.getTable ({ lsp::WindowShape::Hann, 0.001f, 0.001f, 1.0f, 0.001f, 44100 });
+
+    SECTION ("acquire and release are balanced")
+    {
+        auto& a = pool.acquire (8, lsp::StealingPolicy::Oldest);
+        auto& b = pool.acquire (8, lsp::StealingPolicy::Oldest);
+        REQUIRE (pool.getNumActive() == 2);
+        REQUIRE (&a != &b);
+
+        pool.release (a);
+        REQUIRE (pool.getNumActive() == 1);
+        REQUIRE (pool.getActiveGrains().front() == &b);
+    }
+
+    SECTION ("finished grains are released")
+    {
+        for (int i = 0; i < 4; i++)
+            pool.acquire (8, lsp::StealingPolicy::Oldest).reset (0, 100, envelope);
+
+        auto* finished = pool.getActiveGrains()[1];
+        finished->progress = finished->lengthInSamples;
+        pool.releaseFinished();
+
+        REQUIRE (pool.getNumActive() == 3);
+        REQUIRE (envelope.users == 3);
+        for (auto* g : pool.getActiveGrains())
+            REQUIRE (g != finished);
+    }
+
+    SECTION ("oldest grain is stolen when full")
+    {
+        auto& oldest = pool.acquire (2, lsp::StealingPolicy::Oldest);
+        pool.acquire (2, lsp::StealingPolicy::Oldest);
+        auto& stolen = pool.acquire (2, lsp::StealingPolicy::Oldest);
+
+        REQUIRE (&stolen == &oldest);
+        REQUIRE (pool.getNumActive() == 2);
+        REQUIRE (pool.getNumStolen() == 1);
+    }
+
+    SECTION ("quietest grain is stolen when full")
+    {
+        auto& loud = pool.acquire (2, lsp::StealingPolicy::Quietest);
+        auto& quiet = pool.acquire (2, lsp::StealingPolicy::Quietest);
+        loud.envelopeLevel = 0.9f;
+        quiet.envelopeLevel = 0.1f;
+        loud.progress = quiet.progress = 1;
+
+        REQUIRE (&pool.acquire (2, lsp::StealingPolicy::Quietest) == &quiet);
+    }
+
+    SECTION ("grains that haven't played yet aren't stolen as the quietest")
+    {
+        // voices on their way out
+        for (auto level : { 0.3f, 0.05f, 0.2f, 0.1f })
+        {
+            auto& grain = pool.acquire (8, lsp::StealingPolicy::Quietest);
+            grain.reset (0, 100, envelope);
+            grain.progress = grain.lengthInSamples / 2;
+            grain.envelopeLevel = level;
+        }
+        // several starts in the same block, none of them mixed yet
+        std::vector<lsp::Grain*> started;
+        for (int i = 0; i < 4; i++)
+        {
+            started.push_back (&pool.acquire (8, lsp::StealingPolicy::Quietest));
+            started.back()->reset (0, 100, envelope);
+        }
+
+        // the next starts replace the fading voices, quietest first
+        for (auto level : { 0.05f, 0.1f, 0.2f, 0.3f })
+        {
+            auto& grain = pool.acquire (8, lsp::StealingPolicy::Quietest);
+            REQUIRE (grain.progress > 0);
+            REQUIRE (grain.envelopeLevel == level);
+            grain.reset (0, 100, envelope);
+        }
+        // with only new grains left it falls back to the oldest
+        REQUIRE (&pool.acquire (8, lsp::StealingPolicy::Quietest) == started.front());
+    }
+
+    SECTION ("lowering the voice limit sheds grains")
+    {
+        for (int i = 0; i < 6; i++)
+            pool.acquire (8, lsp::StealingPolicy::Oldest);
+
+        pool.acquire (3, lsp::StealingPolicy::Oldest);
+        REQUIRE (pool.getNumActive() == 3);
+        REQUIRE (pool.getNumShed() == 3);
+        REQUIRE (pool.getNumStolen() == 1);
+    }
+
+    SECTION ("a big drop in the voice limit is spread over several spawns")
+    {
+        for (int i = 0; i < 8; i++)
+            pool.acquire (8, lsp::StealingPolicy::Oldest);
+
+        pool.acquire (1, lsp::StealingPolicy::Oldest);
+        REQUIRE (pool.getNumActive() == 8 - lsp::GrainPool::maxShedPerAcquire);
+        pool.acquire (1, lsp::StealingPolicy::Oldest);
+        REQUIRE (pool.getNumActive() == 1);
+        REQUIRE (pool.getNumShed() == 7);
+        REQUIRE (pool.getNumStolen() == 2);
+    }
+}
@@ -0,0 +1,82 @@
+#include "helpers/realtime_checker.h"
+#include "helpers/test_helpers.h"
+#include <catch2/catch_test_macros.hpp>
+
+namespace
+{
+    // three seconds of seeded grains over noise, giving the background thread some time between blocks
+    juce::AudioBuffer<float> render (PluginProcessor& plugin, bool backgroundRender)
+    {
+        setParameter (plugin, "seed", 5.0f);
+        setParameter (plugin, "grainRate", 100.0f);
+        setParameter (plugin, "delayTime", 0.5f);
+        setParameter (plugin, "feedback", 0.0f);
+        setParameter (plugin, "grainAttack", 5.0f);
+        setParameter (plugin, "grainDecay", 5.0f);
+        setParameter (plugin, "grainRelease", 5.0f);
+        setParameter (plugin, "backgroundRender", backgroundRender ? 1.0f : 0.0f);
+        plugin.prepareToPlay (48000.0, 512);
+
+        juce::AudioBuffer<float> output (2, 3 * 48000);
+        juce::AudioBuffer<float> block (2, 512);
+        juce::MidiBuffer midi;
+        juce::Random noise (1);
+        for (int start = 0; start + 512 <= output.getNumSamples(); start += 512)
+        {
+            for (int channel = 0; channel < 2; channel++)
+                for (int i = 0; i < 512; i++)
+                    block.setSample (channel, i, noise.nextFloat() * 2.0f - 1.0f);
+            plugin.processBlock (block, midi);
+            for (int channel = 0; channel < 2; channel++)
+                output.copyFrom (channel, start, block, channel, 0, 512);
+            juce::Thread::sleep (1);
+        }
+        return output;
+    }
+}
+
+TEST_CASE ("Grains rendered in the background", "[prerender]")
+{
+    PluginProcessor background;
+    auto prerendered = render (background, true);
+    auto telemetry = background.getTelemetry().getSnapshot();
+    REQUIRE (telemetry.totalPrerendered > 0);
+
+    SECTION ("sound the same as grains rendered on the audio thread")
+    {
+        // a missed render falls back to the audio thread, so this holds however the worker keeps up
+        PluginProcessor onAudioThread;
+        auto reference = render (onAudioThread, false);
+        REQUIRE (onAudioThread.getTelemetry().getSnapshot().totalPrerendered == 0);
+        auto maxError = 0.0f;
+        for (int channel = 0; channel < 2; channel++)
+            for (int i = 0; i < reference.getNumSamples(); i++)
+                maxError = juce::jmax (maxError, std::abs (reference.getSample (channel, i) - prerendered.getSample (channel, i)));
+        REQUIRE (reference.getMagnitude (0, reference.getNumSamples()) > 0.1f);
+        REQUIRE (maxError < 1.0e-4f);
+    }
+
+    SECTION ("are handed over without locking the audio thread")
+    {
+        juce::AudioBuffer<float> block (2, 512);
+        juce::MidiBuffer midi;
+        juce::Random noise (2);
+        REQUIRE_THAT ([&] {
+            for (int i = 0; i < 200; i++)
+            {
+                for (int channel = 0; channel < 2; channel++)
+                    for (int j = 0; j < 512; j++)
+                        block.setSample (channel, j, noise.nextFloat() * 2.0f - 1.0f);
+                background.processBlock (block, midi);
+            }
+        }, lsp::test::IsRealtimeSafe());
+    }
+
+    SECTION ("are not used offline")
+    {
+        PluginProcessor offline;
+        offline.setNonRealtime (true);
+        render (offline, true);
+        REQUIRE (offline.getTelemetry().getSnapshot().totalPrerendered == 0);
+    }
+}
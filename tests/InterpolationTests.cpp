@@ -0,0 +1,120 @@
+#include <Interpolation.h>
+#include <catch2/catch_approx.hpp>
+#include <catch2/catch_template_test_macros.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+namespace
+{
+    // the value at position, weighted the way the GrainMixer does it
+    template <typename Interpolator>
+    float interpolate (const float* x, double position)
+    {
+        auto index = (int) position;
+        float coefficients[Interpolator::numTaps];
+        Interpolator::getCoefficients ((float) (position - index), coefficients);
+        auto result = 0.0f;
+        for (int tap = 0; tap < Interpolator::numTaps; tap++)
+            result += coefficients[tap] * x[index - Interpolator::before + tap];
+        return result;
+    }
+
+    template <typename Interpolator>
+    std::array<float, Interpolator::numTaps> getCoefficients (float frac)
+    {
+        std::array<float, Interpolator::numTaps> coefficients {};
+        Interpolator::getCoefficients (frac, coefficients.data());
+        return coefficients;
+    }
+}
+
+TEMPLATE_TEST_CASE ("Varispeed interpolation", "[interpolation]", lsp::interpolation::Linear, lsp::interpolation::Cubic, lsp::interpolation::Lagrange, lsp::interpolation::Sinc)
+{
+    static_assert (TestType::before <= lsp::interpolation::margin && TestType::after <= lsp::interpolation::margin);
+    std::array<float, 256> source {};
+    for (size_t i = 0; i < source.size(); i++)
+        source[i] = std::sin ((float) i * 0.05f);
+    auto* start = source.data() + lsp::interpolation::margin;
+
+    SECTION ("integer positions only weight the current sample")
+    {
+        auto coefficients = getCoefficients<TestType> (0.0f);
+        for (int tap = 0; tap < TestType::numTaps; tap++)
+            REQUIRE (coefficients[(size_t) tap] == Catch::Approx (tap == TestType::before ? 1.0f : 0.0f).margin (1.0e-6f));
+    }
+
+    SECTION ("the weights add up to one")
+    {
+        for (auto frac : { 0.1f, 0.25f, 0.5f, 0.9f })
+        {
+            auto coefficients = getCoefficients<TestType> (frac);
+            auto sum = 0.0f;
+            for (auto coefficient : coefficients)
+                sum += coefficient;
+            INFO (frac);
+            REQUIRE (sum == Catch::Approx (1.0f).margin (1.0e-3f));
+        }
+    }
+
+    SECTION ("fractional rates follow the signal")
+    {
+        for (int i = 0; i < 64; i++)
+        {
+            auto position = 0.25 + 1.5 * (double) i;
+            auto expected = std::sin ((float) (lsp::interpolation::margin + position) * 0.05f);
+            REQUIRE (interpolate<TestType> (start, position) == Catch::Approx (expected).margin (1.0e-2f));
+        }
+    }
+
+    SECTION ("negative rates play backwards")
+    {
+        for (int i = 0; i < 64; i++)
+            REQUIRE (interpolate<TestType> (start, 63.0 - i) == Catch::Approx (start[63 - i]).margin (1.0e-4f));
+    }
+}
+
+TEST_CASE ("Interpolation coefficients match their reference values", "[interpolation]")
+{
+    auto requireCoefficients = [] (auto actual, std::initializer_list<double> expected) {
+        REQUIRE (actual.size() == expected.size());
+        auto tap = 0;
+        for (auto value : expected)
+        {
+            INFO (tap);
+            REQUIRE (actual[(size_t) tap++] == Catch::Approx (value).margin (1.0e-6));
+        }
+    };
+
+    SECTION ("Linear")
+    {
+        requireCoefficients (getCoefficients<lsp::interpolation::Linear> (0.25f), { 0.75, 0.25 });
+    }
+
+    SECTION ("Cubic")
+    {
+        requireCoefficients (getCoefficients<lsp::interpolation::Cubic> (0.25f), { -0.0703125, 0.8671875, 0.2265625, -0.0234375 });
+        requireCoefficients (getCoefficients<lsp::interpolation::Cubic> (0.5f), { -0.0625, 0.5625, 0.5625, -0.0625 });
+    }
+
+    SECTION ("Lagrange")
+    {
+        requireCoefficients (getCoefficients<lsp::interpolation::Lagrange> (0.25f), { -0.0546875, 0.8203125, 0.2734375, -0.0390625 });
+        requireCoefficients (getCoefficients<lsp::interpolation::Lagrange> (0.5f), { -0.0625, 0.5625, 0.5625, -0.0625 });
+    }
+
+    SECTION ("Sinc")
+    {
+        // halfway between two samples lands exactly on a phase, so no blending is involved
+        using Sinc = lsp::interpolation::Sinc;
+        auto coefficients = getCoefficients<Sinc> (0.5f);
+        constexpr auto pi = 3.14159265358979323846;
+        for (int tap = 0; tap < Sinc::numTaps; tap++)
+        {
+            auto x = (double) (tap - Sinc::before) - 0.5;
+            auto n = (x + Sinc::numTaps / 2.0) / Sinc::numTaps;
+            auto expected = std::sin (pi * x) / (pi * x) * (0.42 - 0.5 * std::cos (2.0 * pi * n) + 0.08 * std::cos (4.0 * pi * n));
+            INFO (tap);
+            REQUIRE (coefficients[(size_t) tap] == Catch::Approx (expected).margin (1.0e-6));
+            REQUIRE (coefficients[(size_t) tap] == Catch::Approx (coefficients[(size_t) (Sinc::numTaps - 1 - tap)]).margin (1.0e-6));
+        }
+    }
+}
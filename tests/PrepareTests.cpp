@@ -0,0 +1,88 @@
+#include "helpers/realtime_checker.h"
+#include "helpers/test_helpers.h"
+#include <catch2/catch_test_macros.hpp>
+
+namespace
+{
+    // a second of seeded grains over noise
+    juce::AudioBuffer<float> render (PluginProcessor& plugin)
+    {
+        juce::AudioBuffer<float> output (2, 48000);
+        juce::AudioBuffer<float> block (2, 512);
+        juce::MidiBuffer midi;
+        juce::Random noise (1);
+        for (int start = 0; start + 512 <= output.getNumSamples(); start += 512)
+        {
+            for (int channel = 0; channel < 2; channel++)
+                for (int i = 0; i < 512; i++)
+                    block.setSample (channel, i, noise.nextFloat() * 2.0f - 1.0f);
+            plugin.processBlock (block, midi);
+            for (int channel = 0; channel < 2; channel++)
+                output.copyFrom (channel, start, block, channel, 0, 512);
+        }
+        return output;
+    }
+
+    void setUp (PluginProcessor& plugin)
+    {
+        plugin.setNonRealtime (true);
+        setParameter (plugin, "seed", 9.0f);
+        setParameter (plugin, "grainRate", 100.0f);
+        setParameter (plugin, "delayTime", 0.05f);
+        setParameter (plugin, "feedback", 0.5f);
+    }
+}
+
+TEST_CASE ("prepareToPlay reuses what it allocated", "[prepare]")
+{
+    PluginProcessor plugin;
+    setUp (plugin);
+    plugin.prepareToPlay (44100.0, 512);
+    render (plugin);
+
+    SECTION ("and doesn't allocate again for the same settings")
+    {
+        lsp::test::RealtimeChecker::reset();
+        {
+            LSP_REALTIME_SECTION ("prepareToPlay");
+            plugin.prepareToPlay (44100.0, 512);
+        }
+        // the background renderer's thread is still synchronised with, but nothing gets allocated
+        for (const auto& violation : lsp::test::RealtimeChecker::getViolations())
+        {
+            INFO (violation);
+            CHECK (violation.rfind ("mutex lock", 0) == 0);
+        }
+    }
+
+    SECTION ("and renders like a fresh instance after switching the sample rate")
+    {
+        plugin.prepareToPlay (48000.0, 512);
+        auto switched = render (plugin);
+
+        PluginProcessor fresh;
+        setUp (fresh);
+        fresh.prepareToPlay (48000.0, 512);
+        auto reference = render (fresh);
+        REQUIRE (reference.getMagnitude (0, reference.getNumSamples()) > 0.1f);
+        auto maxError = 0.0f;
+        for (int channel = 0; channel < 2; channel++)
+            for (int i = 0; i < reference.getNumSamples(); i++)
+                maxError = juce::jmax (maxError, std::abs (switched.getSample (channel, i) - reference.getSample (channel, i)));
+        REQUIRE (maxError == 0.0f);
+    }
+
+    SECTION ("and frees it in releaseResources")
+    {
+        plugin.releaseResources();
+        juce::AudioBuffer<float> block (2, 512);
+        juce::MidiBuffer midi;
+        block.clear();
+        block.setSample (0, 0, 1.0f);
+        plugin.processBlock (block, midi);
+        REQUIRE (block.getMagnitude (0, 512) == 0.0f);
+
+        plugin.prepareToPlay (44100.0, 512);
+        REQUIRE (render (plugin).getMagnitude (0, 48000) > 0.1f);
+    }
+}
@@ -0,0 +1,139 @@
+#include "helpers/test_helpers.h"
+#include <RateConverter.h>
+#include <catch2/catch_approx.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+namespace
+{
+    float sine (double frequency, double sampleRate, int i)
+    {
+        return (float) std::sin (juce::MathConstants<double>::twoPi * frequency * i / sampleRate);
+    }
+
+    // the largest difference between the output and the input latency samples earlier, once the filters filled up
+    float maxDelayedError (const juce::AudioBuffer<float>& input, const juce::AudioBuffer<float>& output, int latency)
+    {
+        auto maxError = 0.0f;
+        for (int channel = 0; channel < input.getNumChannels(); channel++)
+            for (int i = 2 * latency; i < input.getNumSamples(); i++)
+                maxError = juce::jmax (maxError, std::abs (output.getSample (channel, i) - input.getSample (channel, i - latency)));
+        return maxError;
+    }
+}
+
+TEST_CASE ("Rate converter", "[rate]")
+{
+    auto factor = GENERATE (2, 4);
+    auto sampleRate = 48000.0 * factor;
+    constexpr int maxBlockSize = 512;
+    lsp::RateConverter converter;
+    converter.prepare (2, factor, maxBlockSize);
+    REQUIRE (converter.getLatencyInSamples() == 2 * lsp::RateConverter::zeroCrossings * factor);
+
+    // runs numSamples of the signal down and straight back up, in blocks of uneven lengths
+    auto convert = [&] (std::function<float (int)> signal, int numSamples) {
+        juce::AudioBuffer<float> input (2, numSamples), output (2, numSamples);
+        for (int channel = 0; channel < 2; channel++)
+            for (int i = 0; i < numSamples; i++)
+                input.setSample (channel, i, signal (i) * (channel == 0 ? 1.0f : -0.5f));
+
+        juce::AudioBuffer<float> block (2, maxBlockSize);
+        juce::AudioBuffer<float> engine (2, converter.getMaxEngineBlockSize());
+        juce::Random random (3);
+        converter.reset();
+        for (int start = 0; start < numSamples;)
+        {
+            auto length = juce::jmin (numSamples - start, 1 + random.nextInt (maxBlockSize));
+            for (int channel = 0; channel < 2; channel++)
+                block.copyFrom (channel, 0, input, channel, start, length);
+            auto numEngineSamples = converter.decimate (block.getArrayOfReadPointers(), 0, 2, length, engine.getArrayOfWritePointers());
+            REQUIRE (numEngineSamples <= converter.getMaxEngineBlockSize());
+            converter.interpolate (engine.getArrayOfReadPointers(), numEngineSamples, block.getArrayOfWritePointers(), 0, 2, length);
+            for (int channel = 0; channel < 2; channel++)
+                output.copyFrom (channel, start, block, channel, 0, length);
+            start += length;
+        }
+        return std::pair { input, output };
+    };
+
+    SECTION ("passes the audible band through, delayed by its latency")
+    {
+        for (auto frequency : { 100.0, 1000.0, 10000.0, 19000.0 })
+        {
+            auto [input, output] = convert ([&] (int i) { return sine (frequency, sampleRate, i); }, 20000);
+            INFO (frequency);
+            REQUIRE (maxDelayedError (input, output, converter.getLatencyInSamples()) < 1.0e-3f);
+        }
+    }
+
+    SECTION ("removes what the engine rate can't hold instead of folding it down")
+    {
+        auto [input, output] = convert ([&] (int i) { return sine (30000.0, sampleRate, i); }, 20000);
+        auto latency = converter.getLatencyInSamples();
+        REQUIRE (output.getMagnitude (2 * latency, output.getNumSamples() - 2 * latency) < 1.0e-3f);
+    }
+}
+
+TEST_CASE ("The engine can run below the host rate", "[rate]")
+{
+    PluginProcessor plugin;
+    // dry only, the output is the input as it comes back from the engine
+    setParameter (plugin, "dryMix", 1.0f);
+    setParameter (plugin, "wetMix", 0.0f);
+
+    SECTION ("at the host rate by default")
+    {
+        plugin.prepareToPlay (192000.0, 512);
+        REQUIRE (plugin.getEngineSampleRate() == 192000.0);
+        REQUIRE (plugin.getLatencySamples() == 0);
+    }
+
+    SECTION ("at 48 kHz from 192 kHz, reporting the converter's latency")
+    {
+        setParameter (plugin, "engineRate", 1.0f);
+        plugin.prepareToPlay (192000.0, 500);
+        REQUIRE (plugin.getEngineSampleRate() == 48000.0);
+        auto latency = plugin.getLatencySamples();
+        REQUIRE (latency == 2 * lsp::RateConverter::zeroCrossings * 4);
+
+        // a block size that isn't a multiple of the factor
+        juce::AudioBuffer<float> input (2, 20000), output (2, 20000);
+        for (int channel = 0; channel < 2; channel++)
+            for (int i = 0; i < input.getNumSamples(); i++)
+                input.setSample (channel, i, 0.5f * sine (1000.0, 192000.0, i));
+        juce::AudioBuffer<float> block (2, 500);
+        juce::MidiBuffer midi;
+        for (int start = 0; start + 500 <= input.getNumSamples(); start += 500)
+        {
+            for (int channel = 0; channel < 2; channel++)
+                block.copyFrom (channel, 0, input, channel, start, 500);
+            plugin.processBlock (block, midi);
+            for (int channel = 0; channel < 2; channel++)
+                output.copyFrom (channel, start, block, channel, 0, 500);
+        }
+        REQUIRE (maxDelayedError (input, output, latency) < 1.0e-3f);
+    }
+
+    SECTION ("with the converter's latency in the tail")
+    {
+        setParameter (plugin, "feedback", 0.0f);
+        plugin.prepareToPlay (96000.0, 512);
+        auto hostRateTail = plugin.getTailLengthSeconds();
+        setParameter (plugin, "engineRate", 1.0f);
+        plugin.prepareToPlay (96000.0, 512);
+        REQUIRE (plugin.getLatencySamples() > 0);
+        REQUIRE (plugin.getTailLengthSeconds() == Catch::Approx (hostRateTail + plugin.getLatencySamples() / 96000.0));
+    }
+
+    SECTION ("and back at the host rate after preparing again")
+    {
+        setParameter (plugin, "engineRate", 1.0f);
+        plugin.prepareToPlay (96000.0, 512);
+        REQUIRE (plugin.getEngineSampleRate() == 48000.0);
+        setParameter (plugin, "engineRate", 0.0f);
+        plugin.prepareToPlay (96000.0, 512);
+        REQUIRE (plugin.getEngineSampleRate() == 96000.0);
+        REQUIRE (plugin.getLatencySamples() == 0);
+    }
+}
@@ -0,0 +1,122 @@
+#include "helpers/realtime_checker.h"
+#include "helpers/test_helpers.h"
+#include <PluginProcessor.h>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+TEST_CASE ("processBlock is real-time safe", "[realtime]")
+{
+    auto gui = juce::ScopedJuceInitialiser_GUI {};
+    PluginProcessor plugin;
+
+    constexpr auto blockSize = 512;
+    plugin.prepareToPlay (48000.0, blockSize);
+
+    juce::AudioBuffer<float> buffer (2, blockSize);
+    juce::MidiBuffer midi;
+    juce::Random random (1234);
+
+    auto processBlocks = [&] (int numBlocks) {
+        for (int block = 0; block < numBlocks; block++)
+        {
+            for (int channel = 0; channel < buffer.getNumChannels(); channel++)
+                for (int i = 0; i < blockSize; i++)
+                    buffer.setSample (channel, i, random.nextFloat() * 2.0f - 1.0f);
+            plugin.processBlock (buffer, midi);
+        }
+    };
+
+    // settle once so the first envelope tables etc. exist
+    processBlocks (4);
+
+    SECTION ("grain density sweep")
+    {
+        REQUIRE_THAT ([&] {
+            for (auto rate : { 0.5f, 10.0f, 50.0f, 200.0f })
+            {
+                setParameter (plugin, "grainRate", rate);
+                processBlocks (20);
+            }
+        },
+            lsp::test::IsRealtimeSafe());
+    }
+
+    SECTION ("shape, pitch and delay sweep")
+    {
+        setParameter (plugin, "grainRate", 100.0f);
+        REQUIRE_THAT ([&] {
+            for (auto window : { 0.0f, 1.0f, 2.0f, 3.0f })
+            {
+                setParameter (plugin, "grainWindow", window);
+                setParameter (plugin, "grainAttack", 1.0f + window * 10.0f);
+                setParameter (plugin, "pitchShift", 0.5f + window * 0.5f);
+                setParameter (plugin, "interpolation", window);
+                setParameter (plugin, "delayTime", 0.01f + window * 0.1f);
+                setParameter (plugin, "feedback", 0.9f);
+                processBlocks (20);
+            }
+        },
+            lsp::test::IsRealtimeSafe());
+    }
+
+    SECTION ("voice stealing")
+    {
+        setParameter (plugin, "grainRate", 200.0f);
+        setParameter (plugin, "maxGrains", 16.0f);
+        REQUIRE_THAT ([&] {
+            setParameter (plugin, "grainStealing", 0.0f);
+            processBlocks (50);
+            setParameter (plugin, "grainStealing", 1.0f);
+            processBlocks (50);
+        },
+            lsp::test::IsRealtimeSafe());
+    }
+
+    plugin.releaseResources();
+}
+
+TEST_CASE ("processBlock is real-time safe with more channels than a buffer preallocates", "[realtime]")
+{
+    auto gui = juce::ScopedJuceInitialiser_GUI {};
+    PluginProcessor plugin;
+    // fifth order ambisonics, 36 channels
+    juce::AudioProcessor::BusesLayout layout;
+    layout.inputBuses.add (juce::AudioChannelSet::ambisonic (5));
+    layout.outputBuses.add (juce::AudioChannelSet::ambisonic (5));
+    REQUIRE (plugin.setBusesLayout (layout));
+    REQUIRE (plugin.getTotalNumInputChannels() == 36);
+
+    // the reduced engine rate converts every channel in and out of the engine as well
+    auto reducedRate = GENERATE (false, true);
+    constexpr auto blockSize = 256;
+    setParameter (plugin, "grainRate", 100.0f);
+    setParameter (plugin, "delayTime", 0.01f);
+    setParameter (plugin, "feedback", 0.0f);
+    setParameter (plugin, "engineRate", reducedRate ? 1.0f : 0.0f);
+    plugin.prepareToPlay (reducedRate ? 96000.0 : 48000.0, blockSize);
+    REQUIRE (plugin.getEngineSampleRate() == 48000.0);
+
+    juce::AudioBuffer<float> buffer (36, blockSize);
+    juce::MidiBuffer midi;
+    juce::Random random (1234);
+    auto processBlocks = [&] (int numBlocks, bool silent) {
+        for (int block = 0; block < numBlocks; block++)
+        {
+            for (int channel = 0; channel < buffer.getNumChannels(); channel++)
+                for (int i = 0; i < blockSize; i++)
+                    buffer.setSample (channel, i, silent ? 0.0f : random.nextFloat() * 2.0f - 1.0f);
+            plugin.processBlock (buffer, midi);
+        }
+    };
+    processBlocks (4, false);
+
+    // awake blocks, and silence long enough to fall asleep and wake up again
+    REQUIRE_THAT ([&] {
+        processBlocks (20, false);
+        processBlocks (2500, true);
+        processBlocks (20, false);
+    },
+        lsp::test::IsRealtimeSafe());
+
+    plugin.releaseResources();
+}
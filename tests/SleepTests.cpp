@@ -0,0 +1,107 @@
+#include "helpers/test_helpers.h"
+#include <catch2/catch_approx.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE ("The tail length follows the delay and the feedback", "[sleep]")
+{
+    PluginProcessor plugin;
+    setParameter (plugin, "delayTime", 0.5f);
+    setParameter (plugin, "grainAttack", 10.0f);
+    setParameter (plugin, "grainDecay", 10.0f);
+    setParameter (plugin, "grainRelease", 10.0f);
+
+    // without feedback the tail is a single pass through the delay line
+    setParameter (plugin, "feedback", 0.0f);
+    REQUIRE (plugin.getTailLengthSeconds() == Catch::Approx (2.0 * 0.5 + 0.03));
+
+    setParameter (plugin, "feedback", 0.2f);
+    auto shortTail = plugin.getTailLengthSeconds();
+    setParameter (plugin, "feedback", 0.8f);
+    auto longTail = plugin.getTailLengthSeconds();
+    REQUIRE (shortTail > 1.03);
+    REQUIRE (longTail > shortTail);
+    REQUIRE (longTail <= 60.0);
+}
+
+TEST_CASE ("The processor sleeps through silence", "[sleep]")
+{
+    PluginProcessor plugin;
+    setParameter (plugin, "grainRate", 100.0f);
+    setParameter (plugin, "delayTime", 0.05f);
+    setParameter (plugin, "dryMix", 1.0f);
+    setParameter (plugin, "wetMix", 0.0f);
+    plugin.prepareToPlay (48000.0, 4096);
+
+    juce::AudioBuffer<float> buffer (2, 4096);
+    juce::MidiBuffer midi;
+    buffer.clear();
+    buffer.setSample (0, 0, 0.5f);
+    plugin.processBlock (buffer, midi);
+    REQUIRE_FALSE (plugin.isSleeping());
+
+    // it falls asleep once the silence covers everything a grain can still read: two delay times
+    // plus the spawn variation, or the source of a pitched grain, plus a grain length
+    for (int i = 0; i < 1000 && !plugin.isSleeping(); i++)
+    {
+        buffer.clear();
+        plugin.processBlock (buffer, midi);
+    }
+    REQUIRE (plugin.isSleeping());
+    REQUIRE (plugin.getTelemetry().getSnapshot().sleeping);
+
+    SECTION ("and wakes up on the first audible sample")
+    {
+        buffer.clear();
+        buffer.setSample (1, 100, 0.5f);
+        plugin.processBlock (buffer, midi);
+        REQUIRE_FALSE (plugin.isSleeping());
+        REQUIRE (buffer.getMagnitude (0, 100) == 0.0f);
+        REQUIRE (buffer.getSample (1, 100) == Catch::Approx (0.5f));
+    }
+
+    SECTION ("and stays asleep below the threshold")
+    {
+        for (int i = 0; i < 10; i++)
+        {
+            buffer.clear();
+            buffer.setSample (0, 10, 1.0e-6f);
+            plugin.processBlock (buffer, midi);
+        }
+        REQUIRE (plugin.isSleeping());
+        REQUIRE (plugin.getTelemetry().getSnapshot().activeGrains == 0);
+    }
+}
+
+TEST_CASE ("A shorter delay falls asleep sooner", "[sleep]")
+{
+    // samples of silence after an impulse until the processor falls asleep
+    auto silenceUntilAsleep = [] (float delayTime) {
+        PluginProcessor plugin;
+        setParameter (plugin, "grainRate", 100.0f);
+        setParameter (plugin, "delayTime", delayTime);
+        setParameter (plugin, "feedback", 0.0f);
+        plugin.prepareToPlay (48000.0, 512);
+
+        juce::AudioBuffer<float> buffer (2, 512);
+        juce::MidiBuffer midi;
+        buffer.clear();
+        buffer.setSample (0, 0, 0.5f);
+        plugin.processBlock (buffer, midi);
+
+        auto numSilent = 0;
+        while (!plugin.isSleeping() && numSilent < 48000 * 30)
+        {
+            buffer.clear();
+            plugin.processBlock (buffer, midi);
+            numSilent += 512;
+        }
+        return numSilent;
+    };
+
+    auto shortDelay = silenceUntilAsleep (0.05f);
+    auto longDelay = silenceUntilAsleep (1.0f);
+    // the grains read two delay times back at most, plus the spawn variation and a grain
+    REQUIRE (shortDelay < 48000 / 2);
+    REQUIRE (longDelay >= 2 * 48000);
+    REQUIRE (longDelay < 3 * 48000);
+}
@@ -0,0 +1,91 @@
+#include "helpers/test_helpers.h"
+#include <Telemetry.h>
+#include <catch2/catch_approx.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE ("Telemetry", "[telemetry]")
+{
+    lsp::Telemetry telemetry;
+    auto block = [] (int spawned, float load) {
+        lsp::BlockStats stats;
+        stats.numSamples = 256;
+        stats.activeGrains = spawned * 2;
+        stats.spawned = spawned;
+        stats.stolen = 1;
+        stats.load = load;
+        return stats;
+    };
+
+    SECTION ("snapshots sum up the blocks and hold the latest values")
+    {
+        telemetry.push (block (3, 0.2f));
+        telemetry.push (block (5, 0.6f));
+        auto snapshot = telemetry.getSnapshot();
+        REQUIRE (snapshot.numBlocks == 2);
+        REQUIRE (snapshot.totalSpawned == 8);
+        REQUIRE (snapshot.totalStolen == 2);
+        REQUIRE (snapshot.activeGrains == 10);
+        REQUIRE (snapshot.peakLoad == Catch::Approx (0.6f));
+        REQUIRE (snapshot.averageLoad == Catch::Approx (0.4f));
+
+        // the peak only covers what arrived since the last snapshot
+        telemetry.push (block (1, 0.1f));
+        snapshot = telemetry.getSnapshot();
+        REQUIRE (snapshot.numBlocks == 3);
+        REQUIRE (snapshot.peakLoad == Catch::Approx (0.1f));
+    }
+
+    SECTION ("a full history drops blocks instead of waiting, the snapshot stays current")
+    {
+        constexpr int numPushed = lsp::Telemetry::capacity + 10;
+        for (int i = 0; i < numPushed; i++)
+            telemetry.push (block (1, 0.5f));
+        auto latest = block (7, 0.9f);
+        latest.feedbackLevel = 0.25f;
+        latest.sleeping = true;
+        telemetry.push (latest);
+
+        auto snapshot = telemetry.getSnapshot();
+        REQUIRE (snapshot.numBlocks == numPushed + 1);
+        REQUIRE (snapshot.numDropped == 11);
+        REQUIRE (snapshot.totalSpawned == numPushed + 7);
+        REQUIRE (snapshot.totalStolen == numPushed + 1);
+        REQUIRE (snapshot.activeGrains == 14);
+        REQUIRE (snapshot.load == Catch::Approx (0.9f));
+        REQUIRE (snapshot.peakLoad == Catch::Approx (0.9f));
+        REQUIRE (snapshot.feedbackLevel == Catch::Approx (0.25f));
+        REQUIRE (snapshot.sleeping);
+
+        // the history kept the oldest blocks, and has room again once it's read
+        std::vector<lsp::BlockStats> history (lsp::Telemetry::capacity);
+        REQUIRE (telemetry.readHistory (history.data(), lsp::Telemetry::capacity) == lsp::Telemetry::capacity);
+        REQUIRE (history.front().spawned == 1);
+        telemetry.push (latest);
+        REQUIRE (telemetry.readHistory (history.data(), lsp::Telemetry::capacity) == 1);
+        REQUIRE (history.front().spawned == 7);
+    }
+}
+
+TEST_CASE ("The processor publishes telemetry", "[telemetry]")
+{
+    auto gui = juce::ScopedJuceInitialiser_GUI {};
+    PluginProcessor plugin;
+    setParameter (plugin, "grainRate", 100.0f);
+    setParameter (plugin, "delayTime", 0.05f);
+    setParameter (plugin, "delayTimeVar", 0.0f);
+    plugin.prepareToPlay (48000.0, 256);
+
+    juce::AudioBuffer<float> buffer (2, 256);
+    juce::MidiBuffer midi;
+    for (int i = 0; i < 100; i++)
+    {
+        buffer.clear();
+        plugin.processBlock (buffer, midi);
+    }
+
+    auto snapshot = plugin.getTelemetry().getSnapshot();
+    REQUIRE (snapshot.numBlocks == 100);
+    REQUIRE (snapshot.totalSpawned > 0);
+    REQUIRE (snapshot.activeGrains > 0);
+    REQUIRE (snapshot.renderSeconds > 0.0f);
+}
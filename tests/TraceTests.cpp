@@ -0,0 +1,66 @@
+#include "helpers/test_helpers.h"
+#include <Trace.h>
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE ("Trace", "[trace]")
+{
+    lsp::Trace trace (4);
+
+    SECTION ("keeps the newest events once full")
+    {
+        for (int i = 0; i < 6; i++)
+            trace.addSpan ("span", i * 10, i * 10 + 5, i);
+        REQUIRE (trace.getNumEvents() == 4);
+        REQUIRE (trace.getEvent (0).value == 2.0);
+        REQUIRE (trace.getEvent (3).value == 5.0);
+        REQUIRE (trace.getEvent (3).durationTicks == 5);
+    }
+
+    SECTION ("writes valid Chrome trace JSON")
+    {
+        trace.addSpan ("span", 0, 100);
+        trace.beginAsync ("grain", 7, 1.5);
+        trace.endAsync ("grain", 7);
+
+        juce::MemoryOutputStream stream;
+        trace.writeChromeTrace (stream, "test");
+        auto json = juce::JSON::parse (stream.toString());
+        auto* events = json["traceEvents"].getArray();
+        REQUIRE (events != nullptr);
+        // the process name comes first
+        REQUIRE (events->size() == 4);
+        REQUIRE ((*events)[1]["ph"] == juce::var ("X"));
+        REQUIRE ((*events)[2]["ph"] == juce::var ("b"));
+        REQUIRE ((*events)[2]["id"] == juce::var (7));
+    }
+}
+
+TEST_CASE ("The processor traces its phases when enabled", "[trace]")
+{
+    auto gui = juce::ScopedJuceInitialiser_GUI {};
+    PluginProcessor plugin;
+    setParameter (plugin, "grainRate", 100.0f);
+    setParameter (plugin, "delayTime", 0.01f);
+    plugin.prepareToPlay (48000.0, 256);
+
+    juce::AudioBuffer<float> buffer (2, 256);
+    juce::MidiBuffer midi;
+    auto render = [&] (int numBlocks) {
+        for (int i = 0; i < numBlocks; i++)
+        {
+            buffer.clear();
+            plugin.processBlock (buffer, midi);
+        }
+    };
+
+    render (10);
+    REQUIRE (plugin.getTrace().getNumEvents() == 0);
+
+    plugin.getTrace().setEnabled (true);
+    render (20);
+    juce::StringArray names;
+    for (int i = 0; i < plugin.getTrace().getNumEvents(); i++)
+        names.addIfNotAlreadyThere (plugin.getTrace().getEvent (i).name);
+    for (auto* phase : { "processBlock", "parameters", "capture", "spawn", "mix", "feedback", "cleanup", "output", "grain" })
+        REQUIRE (names.contains (phase));
+}
@@ -0,0 +1,46 @@
+#include <TripleBuffer.h>
+#include <catch2/catch_test_macros.hpp>
+#include <thread>
+
+TEST_CASE ("Triple buffer", "[ui]")
+{
+    lsp::TripleBuffer<int> buffer;
+
+    SECTION ("the reader gets the newest published value once")
+    {
+        REQUIRE_FALSE (buffer.update());
+        buffer.getWriteBuffer() = 1;
+        buffer.publish();
+        buffer.getWriteBuffer() = 2;
+        buffer.publish();
+        REQUIRE (buffer.update());
+        REQUIRE (buffer.getReadBuffer() == 2);
+        REQUIRE_FALSE (buffer.update());
+        REQUIRE (buffer.getReadBuffer() == 2);
+    }
+
+    SECTION ("values only ever move forward across threads")
+    {
+        constexpr int numValues = 100000;
+        std::thread writer ([&] {
+            for (int i = 1; i <= numValues; i++)
+            {
+                buffer.getWriteBuffer() = i;
+                buffer.publish();
+            }
+        });
+
+        auto last = 0;
+        auto ordered = true;
+        while (last < numValues)
+        {
+            if (buffer.update())
+            {
+                ordered = ordered && buffer.getReadBuffer() > last;
+                last = buffer.getReadBuffer();
+            }
+        }
+        writer.join();
+        REQUIRE (ordered);
+    }
+}
@@ -0,0 +1,83 @@
+#include "helpers/test_helpers.h"
+#include <Xoshiro.h>
+#include <catch2/catch_test_macros.hpp>
+#include <cstring>
+
+TEST_CASE ("Xoshiro", "[random]")
+{
+    lsp::Xoshiro a, b;
+    a.prepare (64);
+    b.prepare (64);
+    a.seed (42);
+    b.seed (42);
+
+    SECTION ("the stream doesn't depend on how it's refilled")
+    {
+        for (int i = 0; i < 1000; i++)
+        {
+            if (i % 7 == 0)
+                b.refill (1 + i % 50);
+            REQUIRE (a.nextInt() == b.nextInt());
+        }
+    }
+
+    SECTION ("floats are in [0, 1)")
+    {
+        for (int i = 0; i < 1000; i++)
+        {
+            auto value = a.nextFloat();
+            REQUIRE (value >= 0.0f);
+            REQUIRE (value < 1.0f);
+        }
+    }
+
+    SECTION ("different seeds give different streams")
+    {
+        b.seed (43);
+        auto numEqual = 0;
+        for (int i = 0; i < 100; i++)
+            numEqual += a.nextInt() == b.nextInt() ? 1 : 0;
+        REQUIRE (numEqual < 5);
+    }
+}
+
+TEST_CASE ("Seeded renders are reproducible", "[random]")
+{
+    auto gui = juce::ScopedJuceInitialiser_GUI {};
+
+    auto render = [] (float seed) {
+        PluginProcessor plugin;
+        plugin.setNonRealtime (true);
+        setParameter (plugin, "seed", seed);
+        setParameter (plugin, "grainRate", 100.0f);
+        setParameter (plugin, "delayTime", 0.05f);
+        setParameter (plugin, "delayTimeVar", 0.5f);
+        plugin.prepareToPlay (48000.0, 256);
+
+        juce::AudioBuffer<float> output (2, 48000);
+        juce::AudioBuffer<float> block (2, 256);
+        juce::MidiBuffer midi;
+        juce::Random noise (1);
+        for (int start = 0; start + 256 <= output.getNumSamples(); start += 256)
+        {
+            for (int channel = 0; channel < 2; channel++)
+                for (int i = 0; i < 256; i++)
+                    block.setSample (channel, i, noise.nextFloat() * 2.0f - 1.0f);
+            plugin.processBlock (block, midi);
+            for (int channel = 0; channel < 2; channel++)
+                output.copyFrom (channel, start, block, channel, 0, 256);
+        }
+        return output;
+    };
+
+    auto isEqual = [] (const juce::AudioBuffer<float>& x, const juce::AudioBuffer<float>& y) {
+        for (int channel = 0; channel < x.getNumChannels(); channel++)
+            if (std::memcmp (x.getReadPointer (channel), y.getReadPointer (channel), sizeof (float) * (size_t) x.getNumSamples()) != 0)
+                return false;
+        return true;
+    };
+
+    auto first = render (7.0f);
+    REQUIRE (isEqual (first, render (7.0f)));
+    REQUIRE_FALSE (isEqual (first, render (8.0f)));
+}
@@ -0,0 +1,229 @@
+#include "realtime_checker.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(__linux__) || defined(__APPLE__)
+    #include <execinfo.h>
+    #define LSP_HAS_BACKTRACE 1
+#else
+    #define LSP_HAS_BACKTRACE 0
+#endif
+
+#if defined(__GLIBC__)
+    #include <dlfcn.h>
+    #include <pthread.h>
+extern "C" void* __libc_malloc (size_t);
+extern "C" void* __libc_calloc (size_t, size_t);
+extern "C" void* __libc_realloc (void*, size_t);
+extern "C" void __libc_free (void*);
+#endif
+
+namespace
+{
+    enum class ViolationKind { allocation, deallocation, lock };
+
+    struct Violation
+    {
+        ViolationKind kind;
+        const char* section;
+        size_t size;
+        std::array<void*, 24> frames;
+        int numFrames;
+    };
+
+    // recording must not allocate itself, so violations go into a fixed array
+    constexpr size_t maxViolations = 64;
+    std::array<Violation, maxViolations> violations;
+    std::atomic<size_t> numViolations { 0 };
+
+    // name of the innermost open section on this thread, nullptr outside of sections
+    thread_local const char* currentSection = nullptr;
+    // set while we're inside a hook, so nested allocations aren't reported twice
+    thread_local bool insideHook = false;
+
+    struct BacktracePrimer
+    {
+        // the first backtrace() call loads libgcc and allocates, get that out of the way
+        BacktracePrimer()
+        {
+#if LSP_HAS_BACKTRACE
+            void* frames[1];
+            backtrace (frames, 1);
+#endif
+        }
+    } primer;
+
+    void record (ViolationKind kind, size_t size)
+    {
+        if (currentSection == nullptr || insideHook)
+            return;
+
+        insideHook = true;
+        auto index = numViolations.fetch_add (1);
+        if (index < maxViolations)
+        {
+            auto& violation = violations[index];
+            violation.kind = kind;
+            violation.section = currentSection;
+            violation.size = size;
+#if LSP_HAS_BACKTRACE
+            violation.numFrames = backtrace (violation.frames.data(), (int) violation.frames.size());
+#else
+            violation.numFrames = 0;
+#endif
+        }
+        insideHook = false;
+    }
+
+    void* allocate (size_t size)
+    {
+        record (ViolationKind::allocation, size);
+        auto wasInsideHook = insideHook;
+        insideHook = true;
+        auto* ptr = std::malloc (size == 0 ? 1 : size);
+        insideHook = wasInsideHook;
+        return ptr;
+    }
+
+    void* allocateAligned (size_t size, std::align_val_t alignment)
+    {
+        record (ViolationKind::allocation, size);
+        auto wasInsideHook = insideHook;
+        insideHook = true;
+#if defined(_WIN32)
+        auto* ptr = _aligned_malloc (size == 0 ? 1 : size, static_cast<size_t> (alignment));
+#else
+        void* ptr = nullptr;
+        if (posix_memalign (&ptr, std::max (sizeof (void*), static_cast<size_t> (alignment)), size == 0 ? 1 : size) != 0)
+            ptr = nullptr;
+#endif
+        insideHook = wasInsideHook;
+        return ptr;
+    }
+
+    void deallocate (void* ptr)
+    {
+        if (ptr == nullptr)
+            return;
+        record (ViolationKind::deallocation, 0);
+        auto wasInsideHook = insideHook;
+        insideHook = true;
+        std::free (ptr);
+        insideHook = wasInsideHook;
+    }
+
+    void deallocateAligned (void* ptr)
+    {
+        if (ptr == nullptr)
+            return;
+        record (ViolationKind::deallocation, 0);
+        auto wasInsideHook = insideHook;
+        insideHook = true;
+#if defined(_WIN32)
+        _aligned_free (ptr);
+#else
+        std::free (ptr);
+#endif
+        insideHook = wasInsideHook;
+    }
+
+    std::string describe (const Violation& violation)
+    {
+        std::string kind = violation.kind == ViolationKind::allocation ? "allocation of " + std::to_string (violation.size) + " bytes"
+                           : violation.kind == ViolationKind::deallocation ? "deallocation"
+                                                                             : "mutex lock";
+        std::string result = kind + " inside " + violation.section;
+
+#if LSP_HAS_BACKTRACE
+        if (auto* symbols = backtrace_symbols (violation.frames.data(), violation.numFrames))
+        {
+            // skip the hook's own frames
+            for (int i = 2; i < violation.numFrames; i++)
+                result += std::string ("\n    ") + symbols[i];
+            std::free (symbols);
+        }
+#endif
+        return result;
+    }
+}
+
+namespace lsp
+{
+    ScopedRealtimeSection::ScopedRealtimeSection (const char* name)
+        : previousName (currentSection)
+    {
+        currentSection = name;
+    }
+
+    ScopedRealtimeSection::~ScopedRealtimeSection()
+    {
+        currentSection = previousName;
+    }
+}
+
+namespace lsp::test
+{
+    void RealtimeChecker::reset()
+    {
+        numViolations = 0;
+    }
+
+    std::vector<std::string> RealtimeChecker::getViolations()
+    {
+        std::vector<std::string> result;
+        auto num = std::min (numViolations.load(), maxViolations);
+        for (size_t i = 0; i < num; i++)
+            result.push_back (describe (violations[i]));
+        if (numViolations.load() > maxViolations)
+            result.push_back ("... and " + std::to_string (numViolations.load() - maxViolations) + " more");
+        return result;
+    }
+}
+
+// clang-format off
+void* operator new (size_t size) { if (auto* ptr = allocate (size)) return ptr; throw std::bad_alloc(); }
+void* operator new[] (size_t size) { if (auto* ptr = allocate (size)) return ptr; throw std::bad_alloc(); }
+void* operator new (size_t size, const std::nothrow_t&) noexcept { return allocate (size); }
+void* operator new[] (size_t size, const std::nothrow_t&) noexcept { return allocate (size); }
+void* operator new (size_t size, std::align_val_t alignment) { if (auto* ptr = allocateAligned (size, alignment)) return ptr; throw std::bad_alloc(); }
+void* operator new[] (size_t size, std::align_val_t alignment) { if (auto* ptr = allocateAligned (size, alignment)) return ptr; throw std::bad_alloc(); }
+void* operator new (size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return allocateAligned (size, alignment); }
+void* operator new[] (size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return allocateAligned (size, alignment); }
+
+void operator delete (void* ptr) noexcept { deallocate (ptr); }
+void operator delete[] (void* ptr) noexcept { deallocate (ptr); }
+void operator delete (void* ptr, size_t) noexcept { deallocate (ptr); }
+void operator delete[] (void* ptr, size_t) noexcept { deallocate (ptr); }
+void operator delete (void* ptr, const std::nothrow_t&) noexcept { deallocate (ptr); }
+void operator delete[] (void* ptr, const std::nothrow_t&) noexcept { deallocate (ptr); }
+void operator delete (void* ptr, std::align_val_t) noexcept { deallocateAligned (ptr); }
+void operator delete[] (void* ptr, std::align_val_t) noexcept { deallocateAligned (ptr); }
+void operator delete (void* ptr, size_t, std::align_val_t) noexcept { deallocateAligned (ptr); }
+void operator delete[] (void* ptr, size_t, std::align_val_t) noexcept { deallocateAligned (ptr); }
+void operator delete (void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { deallocateAligned (ptr); }
+void operator delete[] (void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { deallocateAligned (ptr); }
+
+#if defined(__GLIBC__)
+// glibc lets the executable interpose these, which also catches allocations made from inside other libraries
+extern "C" void* malloc (size_t size) { record (ViolationKind::allocation, size); return __libc_malloc (size); }
+extern "C" void* calloc (size_t num, size_t size) { record (ViolationKind::allocation, num * size); return __libc_calloc (num, size); }
+extern "C" void* realloc (void* ptr, size_t size) { record (ViolationKind::allocation, size); return __libc_realloc (ptr, size); }
+extern "C" void free (void* ptr) { if (ptr != nullptr) record (ViolationKind::deallocation, 0); __libc_free (ptr); }
+
+// std::mutex and juce::CriticalSection both end up here
+using MutexLockFunction = int (*) (pthread_mutex_t*);
+static MutexLockFunction realMutexLock = reinterpret_cast<MutexLockFunction> (dlsym (RTLD_NEXT, "pthread_mutex_lock"));
+
+extern "C" int pthread_mutex_lock (pthread_mutex_t* mutex)
+{
+    // static initialisation order isn't guaranteed, something may lock before realMutexLock is set
+    if (realMutexLock == nullptr)
+        realMutexLock = reinterpret_cast<MutexLockFunction> (dlsym (RTLD_NEXT, "pthread_mutex_lock"));
+    record (ViolationKind::lock, 0);
+    return realMutexLock (mutex);
+}
+#endif
+// clang-format on
@@ -0,0 +1,64 @@
+#pragma once
+#include <RealtimeCheck.h>
+#include <catch2/matchers/catch_matchers_templated.hpp>
+#include <string>
+#include <vector>
+
+/* Real-time safety checks for the Tests target.
+ *
+ * The Tests target replaces the global operator new/delete (and malloc/free and
+ * pthread_mutex_lock on Linux). Whenever one of them is hit inside an
+ * LSP_REALTIME_SECTION, such as the one at the top of PluginProcessor::processBlock,
+ * the call and its stack get recorded.
+ *
+ * Example usage
+ *
+  REQUIRE_THAT ([&] {
+      for (auto rate : { 1.0f, 50.0f, 200.0f })
+      {
+          setParameter (plugin, "grainRate", rate);
+          plugin.processBlock (buffer, midi);
+      }
+  }, lsp::test::IsRealtimeSafe());
+
+ */
+namespace lsp::test
+{
+    class RealtimeChecker
+    {
+    public:
+        // forgets everything that was recorded so far
+        static void reset();
+        // one line per violation, with a symbolised stack trace where the platform supports it
+        static std::vector<std::string> getViolations();
+    };
+
+    class RealtimeSafeMatcher : public Catch::Matchers::MatcherGenericBase
+    {
+    public:
+        template <typename Callable>
+        bool match (Callable&& callable) const
+        {
+            RealtimeChecker::reset();
+            callable();
+            violations = RealtimeChecker::getViolations();
+            return violations.empty();
+        }
+
+        std::string describe() const override
+        {
+            std::string description = "runs without allocating or locking on the audio thread";
+            for (const auto& violation : violations)
+                description += "\n" + violation;
+            return description;
+        }
+
+    private:
+        mutable std::vector<std::string> violations;
+    };
+
+    inline RealtimeSafeMatcher IsRealtimeSafe()
+    {
+        return {};
+    }
+}
@@ -19,7 +19,7 @@
    });
 
  */
-[[maybe_unused]] void runWithinPluginEditor (const std::function<void (PluginProcessor& plugin)>& testCode)
+[[maybe_unused]] inline void runWithinPluginEditor (const std::function<void (PluginProcessor& plugin)>& testCode)
 {
     PluginProcessor plugin;
     auto gui = juce::ScopedJuceInitialiser_GUI {};
@@ -30,3 +30,26 @@
     plugin.editorBeingDeleted (editor);
     delete editor;
 }
+
+/* Sets a parameter by its ID to a value in its own (denormalised) range, like the host would
+ *
+ * Example usage
+ *
+  setParameter (plugin, "grainRate", 200.0f);
+
+ */
+[[maybe_unused]] inline void setParameter (juce::AudioProcessor& plugin, const juce::String& parameterID, float value)
+{
+    for (auto* parameter : plugin.getParameters())
+    {
+        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*> (parameter))
+        {
+            if (ranged->getParameterID() == parameterID)
+            {
+                ranged->setValueNotifyingHost (ranged->convertTo0to1 (value));
+                return;
+            }
+        }
+    }
+    jassertfalse; // no parameter with that ID
+}
@@ -0,0 +1,299 @@
+#include <PluginProcessor.h>
+#include <iostream>
+
+/* Renders audio files through the plugin offline, as fast as the machine allows.
+ *
+ * Every file gets its own PluginProcessor on a worker thread and is streamed through processBlock
+ * in large blocks with juce::AudioFormatReader / juce::AudioFormatWriter, so memory use doesn't
+ * depend on the file length. The output keeps the input's format, sample rate and bit depth.
+ *
+ * Example usage
+ *
+  BatchRender --param grainRate=40 --param feedback=0.7 --state preset.xml --output renders *.wav
+
+ */
+namespace
+{
+    struct Options
+    {
+        juce::Array<juce::File> inputs;
+        juce::File outputDirectory;
+        juce::StringPairArray parameters;
+        juce::File stateFile;
+        int blockSize = 8192;
+        int numJobs = juce::SystemStats::getNumCpus();
+        // < 0 uses the plugin's own tail length
+        double tailSeconds = -1.0;
+        // where the Chrome traces go, none are recorded if this is empty
+        juce::File traceDirectory;
+    };
+
+    void printUsage()
+    {
+        std::cout << "usage: BatchRender [options] <input files...>\n"
+                     "  -o, --output <dir>        where the renders go (default: next to each input)\n"
+                     "  -p, --param <id>=<value>  sets a parameter in its own range, can be repeated\n"
+                     "  -s, --state <file>        loads a preset (state XML or a host's binary state)\n"
+                     "  -b, --block-size <n>      samples per processBlock call (default 8192)\n"
+                     "  -j, --jobs <n>            files rendered in parallel (default: number of cores)\n"
+                     "  -t, --tail <seconds>      extra time rendered after the input ends\n"
+                     "  -r, --trace <dir>         writes a Chrome trace of the last blocks of each render\n";
+    }
+
+    bool parseArguments (const juce::StringArray& arguments, Options& options)
+    {
+        for (int i = 0; i < arguments.size(); i++)
+        {
+            const auto& argument = arguments[i];
+            auto hasValue = i + 1 < arguments.size();
+            auto isOption = [&] (const char* shortName, const char* longName) {
+                return argument == shortName || argument == longName;
+            };
+
+            if (isOption ("-h", "--help"))
+                return false;
+            if (argument.startsWith ("-") && !hasValue)
+            {
+                std::cerr << "missing value for " << argument << "\n";
+                return false;
+            }
+
+            if (isOption ("-o", "--output"))
+                options.outputDirectory = juce::File::getCurrentWorkingDirectory().getChildFile (arguments[++i]);
+            else if (isOption ("-p", "--param"))
+            {
+                auto assignment = arguments[++i];
+                if (!assignment.contains ("="))
+                {
+                    std::cerr << "expected <id>=<value>, got " << assignment << "\n";
+                    return false;
+                }
+                options.parameters.set (assignment.upToFirstOccurrenceOf ("=", false, false),
+                    assignment.fromFirstOccurrenceOf ("=", false, false));
+            }
+            else if (isOption ("-s", "--state"))
+                options.stateFile = juce::File::getCurrentWorkingDirectory().getChildFile (arguments[++i]);
+            else if (isOption ("-b", "--block-size"))
+                options.blockSize = juce::jmax (1, arguments[++i].getIntValue());
+            else if (isOption ("-j", "--jobs"))
+                options.numJobs = juce::jmax (1, arguments[++i].getIntValue());
+            else if (isOption ("-t", "--tail"))
+                options.tailSeconds = juce::jmax (0.0, arguments[++i].getDoubleValue());
+            else if (isOption ("-r", "--trace"))
+                options.traceDirectory = juce::File::getCurrentWorkingDirectory().getChildFile (arguments[++i]);
+            else if (argument.startsWith ("-"))
+            {
+                std::cerr << "unknown option " << argument << "\n";
+                return false;
+            }
+            else
+                options.inputs.add (juce::File::getCurrentWorkingDirectory().getChildFile (argument));
+        }
+        return !options.inputs.isEmpty();
+    }
+
+    // stdout is shared by all jobs
+    juce::CriticalSection printLock;
+
+    void print (const juce::String& message, bool isError = false)
+    {
+        const juce::ScopedLock lock (printLock);
+        (isError ? std::cerr : std::cout) << message << "\n";
+    }
+
+    bool applySettings (PluginProcessor& plugin, const Options& options, juce::String& error)
+    {
+        if (options.stateFile != juce::File())
+        {
+            juce::MemoryBlock state;
+            if (!options.stateFile.loadFileAsData (state))
+            {
+                error = "can't read " + options.stateFile.getFullPathName();
+                return false;
+            }
+            // plain XML (like the apvts writes it) gets wrapped the way the host would store it
+            if (auto xml = juce::parseXML (state.toString()))
+            {
+                state.reset();
+                juce::AudioProcessor::copyXmlToBinary (*xml, state);
+            }
+            plugin.setStateInformation (state.getData(), (int) state.getSize());
+        }
+
+        for (const auto& id : options.parameters.getAllKeys())
+        {
+            juce::RangedAudioParameter* parameter = nullptr;
+            for (auto* candidate : plugin.getParameters())
+                if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*> (candidate))
+                    if (ranged->getParameterID() == id)
+                        parameter = ranged;
+
+            if (parameter == nullptr)
+            {
+                error = "unknown parameter " + id;
+                return false;
+            }
+            parameter->setValueNotifyingHost (parameter->convertTo0to1 (options.parameters[id].getFloatValue()));
+        }
+        return true;
+    }
+
+    class RenderJob : public juce::ThreadPoolJob
+    {
+    public:
+        RenderJob (const juce::File& inputFile, const Options& options, juce::AudioFormatManager& formats)
+            : juce::ThreadPoolJob (inputFile.getFileName()), input (inputFile), options (options), formats (formats) {}
+
+        JobStatus runJob() override
+        {
+            juce::String error;
+            if (!render (error))
+            {
+                print (input.getFileName() + ": " + error, true);
+                failed = true;
+            }
+            return jobHasFinished;
+        }
+
+        bool hasFailed() const { return failed; }
+
+    private:
+        bool render (juce::String& error)
+        {
+            std::unique_ptr<juce::AudioFormatReader> reader (formats.createReaderFor (input));
+            if (reader == nullptr)
+            {
+                error = "not a readable audio file";
+                return false;
+            }
+            auto numChannels = (int) reader->numChannels;
+
+            auto directory = options.outputDirectory == juce::File() ? input.getParentDirectory() : options.outputDirectory;
+            auto output = directory.getChildFile (input.getFileNameWithoutExtension() + "_sparkle" + input.getFileExtension());
+            auto* format = formats.findFormatForFileExtension (input.getFileExtension());
+            output.deleteFile();
+            auto stream = output.createOutputStream();
+            if (format == nullptr || stream == nullptr)
+            {
+                error = "can't write " + output.getFullPathName();
+                return false;
+            }
+            std::unique_ptr<juce::AudioFormatWriter> writer (format->createWriterFor (stream.get(),
+                reader->sampleRate,
+                (unsigned int) numChannels,
+                (int) reader->bitsPerSample,
+                reader->metadataValues,
+                0));
+            if (writer == nullptr)
+            {
+                error = "can't write " + output.getFullPathName() + " in this format";
+                return false;
+            }
+            // the writer owns the stream now
+            stream.release();
+
+            PluginProcessor plugin;
+            auto channelSet = juce::AudioChannelSet::canonicalChannelSet (numChannels);
+            juce::AudioProcessor::BusesLayout layout;
+            layout.inputBuses.add (channelSet);
+            layout.outputBuses.add (channelSet);
+            if (!plugin.setBusesLayout (layout) || !applySettings (plugin, options, error))
+            {
+                if (error.isEmpty())
+                    error = "unsupported channel layout";
+                return false;
+            }
+            plugin.setNonRealtime (true);
+            plugin.prepareToPlay (reader->sampleRate, options.blockSize);
+            plugin.getTrace().setEnabled (options.traceDirectory != juce::File());
+
+            auto tailSeconds = options.tailSeconds >= 0.0 ? options.tailSeconds : plugin.getTailLengthSeconds();
+            // a reduced engine rate delays the output, render that much longer and drop it from the front
+            auto latency = (juce::int64) plugin.getLatencySamples();
+            auto totalSamples = reader->lengthInSamples + (juce::int64) std::ceil (tailSeconds * reader->sampleRate) + latency;
+            juce::AudioBuffer<float> buffer (numChannels, options.blockSize);
+            juce::MidiBuffer midi;
+
+            auto start = juce::Time::getHighResolutionTicks();
+            for (juce::int64 position = 0; position < totalSamples; position += options.blockSize)
+            {
+                auto numSamples = (int) juce::jmin ((juce::int64) options.blockSize, totalSamples - position);
+                // reading past the end of the file fills with silence, which renders the tail
+                reader->read (&buffer, 0, numSamples, position, true, true);
+                juce::AudioBuffer<float> block (buffer.getArrayOfWritePointers(), numChannels, numSamples);
+                plugin.processBlock (block, midi);
+                auto numToDrop = (int) juce::jlimit ((juce::int64) 0, (juce::int64) numSamples, latency - position);
+                if (numToDrop < numSamples && !writer->writeFromAudioSampleBuffer (block, numToDrop, numSamples - numToDrop))
+                {
+                    error = "writing " + output.getFullPathName() + " failed";
+                    return false;
+                }
+            }
+            auto elapsed = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+            plugin.releaseResources();
+
+            if (plugin.getTrace().isEnabled())
+            {
+                // the trace keeps the most recent events, open it in ui.perfetto.dev or chrome://tracing
+                auto traceFile = options.traceDirectory.getChildFile (input.getFileNameWithoutExtension() + "_trace.json");
+                if (!plugin.getTrace().writeChromeTrace (traceFile, input.getFileName()))
+                {
+                    error = "writing " + traceFile.getFullPathName() + " failed";
+                    return false;
+                }
+            }
+
+            auto duration = (double) (totalSamples - latency) / reader->sampleRate;
+            print (input.getFileName() + " -> " + output.getFileName() + ": "
+                   + juce::String (duration, 1) + " s in " + juce::String (elapsed, 2) + " s, "
+                   + juce::String (duration / juce::jmax (elapsed, 1.0e-9), 1) + "x realtime");
+            return true;
+        }
+
+        juce::File input;
+        const Options& options;
+        juce::AudioFormatManager& formats;
+        bool failed = false;
+    };
+}
+
+int main (int argc, char* argv[])
+{
+    Options options;
+    juce::StringArray arguments;
+    for (int i = 1; i < argc; i++)
+        arguments.add (juce::CharPointer_UTF8 (argv[i]));
+
+    if (!parseArguments (arguments, options))
+    {
+        printUsage();
+        return 1;
+    }
+    for (const auto& directory : { options.outputDirectory, options.traceDirectory })
+    {
+        if (directory != juce::File() && !directory.createDirectory())
+        {
+            std::cerr << "can't create " << directory.getFullPathName() << "\n";
+            return 1;
+        }
+    }
+
+    // the processor's apvts wants a message manager
+    auto gui = juce::ScopedJuceInitialiser_GUI {};
+    juce::AudioFormatManager formats;
+    formats.registerBasicFormats();
+
+    juce::ThreadPool pool (juce::jmin (options.numJobs, options.inputs.size()));
+    juce::OwnedArray<RenderJob> jobs;
+    for (const auto& input : options.inputs)
+        pool.addJob (jobs.add (new RenderJob (input, options, formats)), false);
+
+    for (auto* job : jobs)
+        while (pool.contains (job))
+            pool.waitForJobToFinish (job, 100);
+
+    auto numFailed = 0;
+    for (auto* job : jobs)
+        numFailed += job->hasFailed() ? 1 : 0;
+    return numFailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,398 @@
+#include "../../tests/helpers/test_helpers.h"
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+/* Worst case block latency of PluginProcessor::processBlock under host-like conditions.
+ *
+ * Where the throughput benchmarks render steady noise in fixed blocks, this simulates minutes
+ * of a session: the host splits its callbacks into blocks of varying size, parameters are swept
+ * by automation, the input has transients and silent stretches, and between callbacks other
+ * "tracks" evict the caches. Every processBlock call goes into a histogram of its duration, and
+ * every host callback into a histogram of the time it took relative to its deadline (the duration
+ * of the audio it covers). p50 / p99 / p99.9 / max of both are printed, written to
+ * latency_benchmarks.json (or wherever LSP_LATENCY_JSON points) and checked against each
+ * scenario's thresholds, so a spike regression fails the run.
+ *
+ * LSP_LATENCY_SECONDS sets the simulated seconds per scenario (default 120),
+ * LSP_LATENCY_SCALE multiplies the thresholds for slower machines (default 1),
+ * LSP_LATENCY_MAX also enforces a limit on the worst callback (in fractions of its deadline).
+ * The parallel scenario is skipped on machines with fewer than minCpusForParallel cores, its
+ * render threads would only be competing with the host thread there.
+ */
+namespace
+{
+    // Log spaced buckets, bucketsPerOctave per doubling from 1 upwards, plus exact count and max.
+    // Percentiles come out as the upper edge of their bucket, so they're at most ~9% high
+    class Histogram
+    {
+    public:
+        static constexpr int bucketsPerOctave = 8;
+        static constexpr int numOctaves = 40;
+
+        void add (double value)
+        {
+            auto index = value <= 1.0 ? 0 : (int) std::ceil (std::log2 (value) * bucketsPerOctave);
+            buckets[(size_t) juce::jlimit (0, numBuckets - 1, index)]++;
+            count++;
+            max = juce::jmax (max, value);
+        }
+
+        // the value below which the fraction p of all values lie
+        double getPercentile (double p) const
+        {
+            auto target = (juce::uint64) std::ceil (p * (double) count);
+            juce::uint64 seen = 0;
+            for (int i = 0; i < numBuckets; i++)
+            {
+                seen += buckets[(size_t) i];
+                if (seen >= juce::jmax ((juce::uint64) 1, target))
+                    return juce::jmin (max, std::exp2 ((double) i / bucketsPerOctave));
+            }
+            return max;
+        }
+
+        juce::uint64 getCount() const { return count; }
+        double getMax() const { return max; }
+
+        // one row per octave that has values in it
+        void print (const char* unit, double scale) const
+        {
+            juce::uint64 largest = 1;
+            for (int octave = 0; octave < numOctaves; octave++)
+                largest = juce::jmax (largest, getOctaveCount (octave));
+            for (int octave = 0; octave < numOctaves; octave++)
+            {
+                auto octaveCount = getOctaveCount (octave);
+                if (octaveCount == 0)
+                    continue;
+                std::cout << "    <" << std::setw (10) << std::setprecision (3) << std::exp2 (octave + 1) * scale << " " << unit
+                          << std::setw (10) << octaveCount << " "
+                          << std::string ((size_t) std::ceil (40.0 * (double) octaveCount / (double) largest), '#') << "\n";
+            }
+        }
+
+    private:
+        static constexpr int numBuckets = bucketsPerOctave * numOctaves;
+
+        juce::uint64 getOctaveCount (int octave) const
+        {
+            juce::uint64 sum = 0;
+            for (int i = octave * bucketsPerOctave + 1; i <= (octave + 1) * bucketsPerOctave && i < numBuckets; i++)
+                sum += buckets[(size_t) i];
+            return sum + (octave == 0 ? buckets[0] : 0);
+        }
+
+        std::array<juce::uint64, numBuckets> buckets {};
+        juce::uint64 count = 0;
+        double max = 0.0;
+    };
+
+    // limits for the host callbacks, in fractions of their deadline
+    struct Thresholds
+    {
+        double p50;
+        double p99;
+        double p999;
+    };
+
+    struct Scenario
+    {
+        const char* name;
+        double sampleRate;
+        // the host's buffer size, the callbacks split it into smaller blocks now and then
+        int hostBlockSize;
+        float grainRate;
+        float feedback;
+        int interpolation;
+        bool parallelRender;
+        Thresholds thresholds;
+    };
+
+    constexpr int minCpusForParallel = 4;
+
+    struct Result
+    {
+        const Scenario& scenario;
+        // processBlock calls in ns, host callbacks relative to their deadline
+        Histogram blockNanoseconds;
+        Histogram callbackLoad;
+        juce::uint64 numMissedDeadlines = 0;
+    };
+
+    double getEnvironmentDouble (const char* name, double defaultValue)
+    {
+        auto value = juce::SystemStats::getEnvironmentVariable (name, {});
+        return value.isEmpty() ? defaultValue : value.getDoubleValue();
+    }
+
+    // a parameter a fake automation lane sweeps, from 0 to 1 and back over periodSeconds
+    struct AutomationLane
+    {
+        juce::RangedAudioParameter* parameter;
+        double periodSeconds;
+    };
+
+    juce::RangedAudioParameter* findParameter (PluginProcessor& plugin, const juce::String& id)
+    {
+        for (auto* candidate : plugin.getParameters())
+            if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*> (candidate))
+                if (ranged->getParameterID() == id)
+                    return ranged;
+        jassertfalse;
+        return nullptr;
+    }
+
+    // Splits a host buffer into the block sizes processBlock gets. Most callbacks are one full
+    // block, some are split at an automation point, and a few come in as a burst of small blocks
+    // (like hosts that align blocks to events or loop points)
+    void splitHostBlock (int hostBlockSize, juce::Random& random, std::vector<int>& blockSizes)
+    {
+        blockSizes.clear();
+        auto dice = random.nextFloat();
+        if (dice < 0.7f || hostBlockSize < 32)
+            blockSizes.push_back (hostBlockSize);
+        else if (dice < 0.9f)
+        {
+            auto split = 1 + random.nextInt (hostBlockSize - 1);
+            blockSizes.push_back (split);
+            blockSizes.push_back (hostBlockSize - split);
+        }
+        else
+        {
+            for (int remaining = hostBlockSize; remaining > 0;)
+            {
+                auto size = juce::jmin (remaining, 1 + random.nextInt (32));
+                blockSizes.push_back (size);
+                remaining -= size;
+            }
+        }
+    }
+
+    // Noise at a moderate level with the occasional loud burst, and stretches of silence long
+    // enough for the processor to fall asleep and wake up again
+    class InputGenerator
+    {
+    public:
+        explicit InputGenerator (double sampleRate) : sampleRate (sampleRate) {}
+
+        void fill (juce::AudioBuffer<float>& buffer, int numSamples)
+        {
+            for (int i = 0; i < numSamples; i++)
+            {
+                if (--samplesUntilChange <= 0)
+                    pickNextSection();
+                auto sample = silent ? 0.0f : (random.nextFloat() * 2.0f - 1.0f) * level;
+                level = juce::jmax (0.1f, level * burstDecay);
+                for (int channel = 0; channel < buffer.getNumChannels(); channel++)
+                    buffer.setSample (channel, i, sample);
+            }
+        }
+
+    private:
+        void pickNextSection()
+        {
+            auto dice = random.nextFloat();
+            silent = dice < 0.05f;
+            // a transient: jumps to full scale and decays back within ~50 ms
+            if (!silent && dice < 0.3f)
+                level = 1.0f;
+            samplesUntilChange = (int) (sampleRate * (silent ? 5.0 + 10.0 * random.nextDouble() : 0.05 + 0.5 * random.nextDouble()));
+        }
+
+        double sampleRate;
+        juce::Random random { 7 };
+        bool silent = false;
+        float level = 0.1f;
+        float burstDecay = 0.9995f;
+        int samplesUntilChange = 0;
+    };
+
+    // what the other tracks of a session do to the caches between our callbacks
+    class CacheThrasher
+    {
+    public:
+        void run (juce::Random& random)
+        {
+            if (random.nextFloat() > 0.25f)
+                return;
+            for (size_t i = 0; i < memory.size(); i += 16)
+                memory[i] += 1;
+        }
+
+    private:
+        std::vector<int> memory = std::vector<int> (8 * 1024 * 1024);
+    };
+
+    Result run (const Scenario& scenario, double secondsToRender)
+    {
+        PluginProcessor plugin;
+        setParameter (plugin, "grainRate", scenario.grainRate);
+        setParameter (plugin, "feedback", scenario.feedback);
+        setParameter (plugin, "interpolation", (float) scenario.interpolation);
+        setParameter (plugin, "parallelRender", scenario.parallelRender ? 1.0f : 0.0f);
+        setParameter (plugin, "seed", 11.0f);
+        plugin.prepareToPlay (scenario.sampleRate, scenario.hostBlockSize);
+
+        // sweeps of the parameters that change the work per block the most
+        std::vector<AutomationLane> lanes {
+            { findParameter (plugin, "grainRate"), 17.0 },
+            { findParameter (plugin, "delayTime"), 23.0 },
+            { findParameter (plugin, "pitchShift"), 7.0 },
+            { findParameter (plugin, "grainAttack"), 11.0 },
+            { findParameter (plugin, "grainRelease"), 13.0 },
+            { findParameter (plugin, "dryMix"), 5.0 },
+        };
+        auto* grainRate = lanes.front().parameter;
+        auto baseGrainRate = grainRate->convertTo0to1 (scenario.grainRate);
+
+        juce::AudioBuffer<float> buffer (2, scenario.hostBlockSize);
+        juce::MidiBuffer midi;
+        juce::Random random (3);
+        InputGenerator input (scenario.sampleRate);
+        CacheThrasher thrasher;
+        std::vector<int> blockSizes;
+        blockSizes.reserve ((size_t) scenario.hostBlockSize);
+
+        Result result { scenario, {}, {} };
+        // the first seconds fill the delay line, the grains don't play at full density before that
+        auto warmUpSamples = (juce::int64) (2.0 * scenario.sampleRate);
+        auto totalSamples = warmUpSamples + (juce::int64) (secondsToRender * scenario.sampleRate);
+        auto deadlineSeconds = scenario.hostBlockSize / scenario.sampleRate;
+        for (juce::int64 position = 0; position < totalSamples; position += scenario.hostBlockSize)
+        {
+            thrasher.run (random);
+            input.fill (buffer, scenario.hostBlockSize);
+            splitHostBlock (scenario.hostBlockSize, random, blockSizes);
+
+            auto callbackSeconds = 0.0;
+            auto offset = 0;
+            for (auto blockSize : blockSizes)
+            {
+                // the host applies automation between blocks, outside of processBlock
+                auto time = (double) (position + offset) / scenario.sampleRate;
+                for (const auto& lane : lanes)
+                {
+                    auto value = 0.5f - 0.5f * (float) std::cos (juce::MathConstants<double>::twoPi * time / lane.periodSeconds);
+                    // the density stays around the scenario's, so the scenarios stay apart
+                    lane.parameter->setValue (lane.parameter == grainRate ? juce::jmin (1.0f, baseGrainRate * (0.5f + value)) : value);
+                }
+
+                juce::AudioBuffer<float> block (buffer.getArrayOfWritePointers(), 2, offset, blockSize);
+                auto start = std::chrono::steady_clock::now();
+                plugin.processBlock (block, midi);
+                auto seconds = std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+                offset += blockSize;
+
+                if (position >= warmUpSamples)
+                    result.blockNanoseconds.add (seconds * 1.0e9);
+                callbackSeconds += seconds;
+            }
+
+            if (position >= warmUpSamples)
+            {
+                result.callbackLoad.add (callbackSeconds / deadlineSeconds);
+                result.numMissedDeadlines += callbackSeconds > deadlineSeconds ? 1 : 0;
+            }
+        }
+        return result;
+    }
+
+    juce::var toJSON (const Histogram& histogram)
+    {
+        auto* object = new juce::DynamicObject();
+        object->setProperty ("count", (juce::int64) histogram.getCount());
+        object->setProperty ("p50", histogram.getPercentile (0.5));
+        object->setProperty ("p99", histogram.getPercentile (0.99));
+        object->setProperty ("p99.9", histogram.getPercentile (0.999));
+        object->setProperty ("max", histogram.getMax());
+        return object;
+    }
+
+    juce::var toJSON (const Result& result)
+    {
+        const auto& s = result.scenario;
+        auto* object = new juce::DynamicObject();
+        object->setProperty ("name", s.name);
+        object->setProperty ("sampleRate", s.sampleRate);
+        object->setProperty ("hostBlockSize", s.hostBlockSize);
+        object->setProperty ("grainRate", s.grainRate);
+        object->setProperty ("feedback", s.feedback);
+        object->setProperty ("interpolation", s.interpolation);
+        object->setProperty ("parallelRender", s.parallelRender);
+        object->setProperty ("blockNanoseconds", toJSON (result.blockNanoseconds));
+        object->setProperty ("callbackLoad", toJSON (result.callbackLoad));
+        object->setProperty ("missedDeadlines", (juce::int64) result.numMissedDeadlines);
+        return object;
+    }
+
+    void print (const Result& result)
+    {
+        const auto& s = result.scenario;
+        const auto& blocks = result.blockNanoseconds;
+        const auto& load = result.callbackLoad;
+        std::cout << std::fixed << std::setprecision (1)
+                  << s.name << ": " << s.sampleRate << " Hz, " << s.hostBlockSize << " smp host blocks, "
+                  << s.grainRate << " grains/s, " << s.feedback << " fb\n"
+                  << "  processBlock  p50 " << blocks.getPercentile (0.5) / 1000.0
+                  << " us, p99 " << blocks.getPercentile (0.99) / 1000.0
+                  << " us, p99.9 " << blocks.getPercentile (0.999) / 1000.0
+                  << " us, max " << blocks.getMax() / 1000.0 << " us (" << blocks.getCount() << " blocks)\n"
+                  << "  callbacks     p50 " << load.getPercentile (0.5) * 100.0
+                  << "%, p99 " << load.getPercentile (0.99) * 100.0
+                  << "%, p99.9 " << load.getPercentile (0.999) * 100.0
+                  << "%, max " << load.getMax() * 100.0 << "% of the deadline, "
+                  << result.numMissedDeadlines << " of " << load.getCount() << " missed\n";
+        blocks.print ("us", 1.0e-3);
+    }
+}
+
+TEST_CASE ("processBlock latency under host jitter", "[latency]")
+{
+    auto gui = juce::ScopedJuceInitialiser_GUI {};
+
+    auto secondsToRender = getEnvironmentDouble ("LSP_LATENCY_SECONDS", 120.0);
+    auto scale = getEnvironmentDouble ("LSP_LATENCY_SCALE", 1.0);
+    auto maxLoad = getEnvironmentDouble ("LSP_LATENCY_MAX", 0.0);
+
+    // Baselines with headroom for CI machines. The median stays well below the deadline,
+    // the rare spikes (allocation, a burst of starts, a sleep / wake up) must still fit in it
+    const std::vector<Scenario> scenarios {
+        { "typical", 48000.0, 256, 20.0f, 0.5f, 1, false, { 0.15, 0.5, 0.8 } },
+        { "dense", 48000.0, 128, 150.0f, 0.9f, 3, false, { 0.3, 0.7, 1.0 } },
+        { "high rate", 96000.0, 512, 80.0f, 0.7f, 2, false, { 0.3, 0.7, 1.0 } },
+        { "parallel", 48000.0, 256, 150.0f, 0.9f, 3, true, { 0.3, 0.7, 1.0 } },
+    };
+
+    juce::Array<juce::var> results;
+    for (const auto& scenario : scenarios)
+    {
+        if (scenario.parallelRender && juce::SystemStats::getNumCpus() < minCpusForParallel)
+        {
+            std::cout << scenario.name << ": skipped, only " << juce::SystemStats::getNumCpus() << " cores\n";
+            continue;
+        }
+        auto result = run (scenario, secondsToRender);
+        print (result);
+        results.add (toJSON (result));
+
+        const auto& load = result.callbackLoad;
+        CHECK (load.getPercentile (0.5) <= scenario.thresholds.p50 * scale);
+        CHECK (load.getPercentile (0.99) <= scenario.thresholds.p99 * scale);
+        CHECK (load.getPercentile (0.999) <= scenario.thresholds.p999 * scale);
+        if (maxLoad > 0.0)
+            CHECK (load.getMax() <= maxLoad * scale);
+    }
+
+    auto* report = new juce::DynamicObject();
+    report->setProperty ("version", VERSION);
+    report->setProperty ("buildType", CMAKE_BUILD_TYPE);
+    report->setProperty ("secondsPerScenario", secondsToRender);
+    report->setProperty ("results", results);
+
+    auto path = juce::SystemStats::getEnvironmentVariable ("LSP_LATENCY_JSON", "latency_benchmarks.json");
+    auto file = juce::File::getCurrentWorkingDirectory().getChildFile (path);
+    REQUIRE (file.replaceWithText (juce::JSON::toString (juce::var (report))));
+    std::cout << "wrote " << file.getFullPathName() << "\n";
+}
@@ -0,0 +1,495 @@
+#include <PluginProcessor.h>
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <thread>
+
+#if defined(__GLIBC__)
+    #include <malloc.h>
+#elif JUCE_MAC
+    #include <malloc/malloc.h>
+#endif
+
+#if JUCE_LINUX
+    #include <linux/perf_event.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+/* Runs many plugin instances at once, the way a large session does, and reports how they scale.
+ *
+ * For every instance count N, N PluginProcessors are created and prepared, split round robin over
+ * M host threads, and driven period by period: all threads start a period together, each processes
+ * a block on every instance it owns, and the period ends when the slowest thread is done (like a
+ * host's audio graph). Every step reports the aggregate realtime factor, the period load against
+ * its deadline, time per instance and block, heap per instance, allocations on the host threads
+ * (each one can contend on the allocator's locks) and, on Linux, cache misses per instance and
+ * block. The curve is written to stress_scaling.json, and --compare prints a previous run's
+ * realtime factors next to the new ones.
+ *
+ * Example usage
+ *
+  StressHarness --instances 1,16,64,200 --threads 8 --seconds 20 --compare last_release.json
+
+ */
+namespace
+{
+    // Every operator new in the process goes through these counters. Blocks carry their size and
+    // the pointer malloc returned in a header, so the heap in use is known at any time
+    std::atomic<juce::int64> liveBytes { 0 };
+    std::atomic<juce::int64> hostThreadAllocations { 0 };
+    thread_local bool isHostThread = false;
+
+    struct AllocationHeader
+    {
+        void* base;
+        size_t size;
+    };
+
+    void* allocate (size_t size, size_t alignment = alignof (std::max_align_t))
+    {
+        alignment = juce::jmax (alignment, alignof (AllocationHeader));
+        auto* base = static_cast<char*> (std::malloc (size + sizeof (AllocationHeader) + alignment));
+        if (base == nullptr)
+            return nullptr;
+        auto address = reinterpret_cast<std::uintptr_t> (base + sizeof (AllocationHeader));
+        auto* ptr = reinterpret_cast<char*> ((address + alignment - 1) & ~(std::uintptr_t) (alignment - 1));
+        reinterpret_cast<AllocationHeader*> (ptr)[-1] = { base, size };
+        liveBytes.fetch_add ((juce::int64) size, std::memory_order_relaxed);
+        if (isHostThread)
+            hostThreadAllocations.fetch_add (1, std::memory_order_relaxed);
+        return ptr;
+    }
+
+    void deallocate (void* ptr)
+    {
+        if (ptr == nullptr)
+            return;
+        auto header = static_cast<AllocationHeader*> (ptr)[-1];
+        liveBytes.fetch_sub ((juce::int64) header.size, std::memory_order_relaxed);
+        std::free (header.base);
+    }
+
+    // bytes the heap has handed out, including what JUCE's HeapBlocks malloc directly where the
+    // C library can tell, otherwise only what went through operator new
+    juce::int64 getHeapInUse()
+    {
+#if defined(__GLIBC__)
+    #if __GLIBC_PREREQ(2, 33)
+        auto info = mallinfo2();
+        return (juce::int64) (info.uordblks + info.hblkhd);
+    #else
+        return liveBytes.load();
+    #endif
+#elif JUCE_MAC
+        return (juce::int64) mstats().bytes_used;
+#else
+        return liveBytes.load();
+#endif
+    }
+
+    struct Options
+    {
+        juce::Array<int> instanceCounts { 1, 2, 4, 8, 16, 32, 64, 128, 200 };
+        int numThreads = juce::jmax (1, juce::SystemStats::getNumCpus());
+        double sampleRate = 48000.0;
+        int blockSize = 256;
+        // measured per step, after the delay lines filled up
+        double seconds = 10.0;
+        juce::StringPairArray parameters;
+        juce::File output = juce::File::getCurrentWorkingDirectory().getChildFile ("stress_scaling.json");
+        juce::File compareWith;
+    };
+
+    void printUsage()
+    {
+        std::cout << "usage: StressHarness [options]\n"
+                     "  -n, --instances <list>     instance counts to step through (default 1,2,4,8,16,32,64,128,200)\n"
+                     "  -j, --threads <n>          host threads the instances are spread over (default: number of cores)\n"
+                     "  -r, --sample-rate <hz>     (default 48000)\n"
+                     "  -b, --block-size <n>       samples per period (default 256)\n"
+                     "  -s, --seconds <n>          simulated seconds per step (default 10)\n"
+                     "  -p, --param <id>=<value>   sets a parameter on every instance, can be repeated\n"
+                     "  -o, --output <file>        where the curve goes (default stress_scaling.json)\n"
+                     "  -c, --compare <file>       a previous output to compare the realtime factors with\n";
+    }
+
+    bool parseArguments (const juce::StringArray& arguments, Options& options)
+    {
+        for (int i = 0; i < arguments.size(); i++)
+        {
+            const auto& argument = arguments[i];
+            auto isOption = [&] (const char* shortName, const char* longName) {
+                return argument == shortName || argument == longName;
+            };
+
+            if (isOption ("-h", "--help"))
+                return false;
+            if (i + 1 >= arguments.size())
+            {
+                std::cerr << "missing value for " << argument << "\n";
+                return false;
+            }
+
+            if (isOption ("-n", "--instances"))
+            {
+                options.instanceCounts.clear();
+                for (const auto& count : juce::StringArray::fromTokens (arguments[++i], ",", {}))
+                    options.instanceCounts.add (juce::jmax (1, count.getIntValue()));
+            }
+            else if (isOption ("-j", "--threads"))
+                options.numThreads = juce::jmax (1, arguments[++i].getIntValue());
+            else if (isOption ("-r", "--sample-rate"))
+                options.sampleRate = juce::jmax (8000.0, arguments[++i].getDoubleValue());
+            else if (isOption ("-b", "--block-size"))
+                options.blockSize = juce::jmax (1, arguments[++i].getIntValue());
+            else if (isOption ("-s", "--seconds"))
+                options.seconds = juce::jmax (0.1, arguments[++i].getDoubleValue());
+            else if (isOption ("-p", "--param"))
+            {
+                auto assignment = arguments[++i];
+                if (!assignment.contains ("="))
+                {
+                    std::cerr << "expected <id>=<value>, got " << assignment << "\n";
+                    return false;
+                }
+                options.parameters.set (assignment.upToFirstOccurrenceOf ("=", false, false),
+                    assignment.fromFirstOccurrenceOf ("=", false, false));
+            }
+            else if (isOption ("-o", "--output"))
+                options.output = juce::File::getCurrentWorkingDirectory().getChildFile (arguments[++i]);
+            else if (isOption ("-c", "--compare"))
+                options.compareWith = juce::File::getCurrentWorkingDirectory().getChildFile (arguments[++i]);
+            else
+            {
+                std::cerr << "unknown option " << argument << "\n";
+                return false;
+            }
+        }
+        return !options.instanceCounts.isEmpty();
+    }
+
+    bool applyParameters (PluginProcessor& plugin, const juce::StringPairArray& parameters)
+    {
+        for (const auto& id : parameters.getAllKeys())
+        {
+            juce::RangedAudioParameter* parameter = nullptr;
+            for (auto* candidate : plugin.getParameters())
+                if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*> (candidate))
+                    if (ranged->getParameterID() == id)
+                        parameter = ranged;
+
+            if (parameter == nullptr)
+            {
+                std::cerr << "unknown parameter " << id << "\n";
+                return false;
+            }
+            parameter->setValueNotifyingHost (parameter->convertTo0to1 (parameters[id].getFloatValue()));
+        }
+        return true;
+    }
+
+    // Hardware cache misses of the calling thread, where the platform lets us count them
+    class CacheMissCounter
+    {
+    public:
+        CacheMissCounter()
+        {
+#if JUCE_LINUX
+            perf_event_attr attributes {};
+            attributes.type = PERF_TYPE_HARDWARE;
+            attributes.size = sizeof (attributes);
+            attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+            attributes.disabled = 1;
+            attributes.exclude_kernel = 1;
+            attributes.exclude_hv = 1;
+            descriptor = (int) syscall (SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+#endif
+        }
+
+        ~CacheMissCounter()
+        {
+#if JUCE_LINUX
+            if (descriptor >= 0)
+                close (descriptor);
+#endif
+        }
+
+        void start()
+        {
+#if JUCE_LINUX
+            if (descriptor >= 0)
+            {
+                ioctl (descriptor, PERF_EVENT_IOC_RESET, 0);
+                ioctl (descriptor, PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+        }
+
+        // misses since start(), or -1 if they can't be counted
+        juce::int64 stop()
+        {
+#if JUCE_LINUX
+            juce::int64 count = 0;
+            if (descriptor >= 0 && ioctl (descriptor, PERF_EVENT_IOC_DISABLE, 0) == 0
+                && read (descriptor, &count, sizeof (count)) == (ssize_t) sizeof (count))
+                return count;
+#endif
+            return -1;
+        }
+
+    private:
+        int descriptor = -1;
+
+        JUCE_DECLARE_NON_COPYABLE (CacheMissCounter)
+    };
+
+    struct Step
+    {
+        int numInstances = 0;
+        double realtimeFactor = 0.0;
+        // wall time of a period relative to the audio it covers
+        double meanLoad = 0.0;
+        double p99Load = 0.0;
+        int missedDeadlines = 0;
+        double nsPerInstanceBlock = 0.0;
+        double bytesPerInstance = 0.0;
+        juce::int64 hostThreadAllocations = 0;
+        // < 0 where cache misses can't be counted
+        double cacheMissesPerInstanceBlock = -1.0;
+    };
+
+    // the instances one host thread processes every period
+    struct HostThread
+    {
+        std::vector<PluginProcessor*> instances;
+        juce::AudioBuffer<float> buffer;
+        double busySeconds = 0.0;
+        juce::int64 cacheMisses = 0;
+    };
+
+    bool run (const Options& options, int numInstances, const juce::AudioBuffer<float>& input, Step& step)
+    {
+        step.numInstances = numInstances;
+        auto bytesBefore = getHeapInUse();
+        std::vector<std::unique_ptr<PluginProcessor>> instances;
+        for (int i = 0; i < numInstances; i++)
+        {
+            auto& plugin = *instances.emplace_back (std::make_unique<PluginProcessor>());
+            if (!applyParameters (plugin, options.parameters))
+                return false;
+            plugin.prepareToPlay (options.sampleRate, options.blockSize);
+        }
+        step.bytesPerInstance = (double) (getHeapInUse() - bytesBefore) / numInstances;
+
+        // round robin, like a host spreading its tracks over its worker threads
+        auto numThreads = juce::jmin (options.numThreads, numInstances);
+        std::vector<HostThread> hostThreads ((size_t) numThreads);
+        for (int i = 0; i < numInstances; i++)
+            hostThreads[(size_t) (i % numThreads)].instances.push_back (instances[(size_t) i].get());
+        for (auto& hostThread : hostThreads)
+            hostThread.buffer.setSize (input.getNumChannels(), options.blockSize);
+
+        // the delay lines fill up before anything is measured, grains only play after one delay
+        auto periodSeconds = options.blockSize / options.sampleRate;
+        auto numWarmUpPeriods = (int) std::ceil (3.0 / periodSeconds);
+        auto numPeriods = (int) std::ceil (options.seconds / periodSeconds);
+        std::vector<double> periodLoads;
+        periodLoads.reserve ((size_t) numPeriods);
+        auto periodStart = std::chrono::steady_clock::now();
+        auto measureStart = periodStart;
+        int period = 0;
+        // runs on one thread once every thread finished the period
+        auto endPeriod = [&]() noexcept {
+            auto now = std::chrono::steady_clock::now();
+            if (period == numWarmUpPeriods)
+                measureStart = now;
+            else if (period > numWarmUpPeriods)
+                periodLoads.push_back (std::chrono::duration<double> (now - periodStart).count() / periodSeconds);
+            periodStart = now;
+            period++;
+        };
+        std::barrier periodBarrier (numThreads, endPeriod);
+
+        auto allocationsBefore = hostThreadAllocations.load();
+        std::vector<std::thread> threads;
+        for (auto& hostThread : hostThreads)
+        {
+            threads.emplace_back ([&, &hostThread = hostThread] {
+                isHostThread = true;
+                CacheMissCounter cacheMisses;
+                juce::MidiBuffer midi;
+                // one extra round so the last measured period gets its end time
+                for (int p = 0; p < numWarmUpPeriods + numPeriods + 1; p++)
+                {
+                    if (p == numWarmUpPeriods + 1)
+                        cacheMisses.start();
+                    auto start = std::chrono::steady_clock::now();
+                    for (auto* plugin : hostThread.instances)
+                    {
+                        for (int channel = 0; channel < hostThread.buffer.getNumChannels(); channel++)
+                            hostThread.buffer.copyFrom (channel, 0, input, channel, (p * options.blockSize) % (input.getNumSamples() - options.blockSize), options.blockSize);
+                        plugin->processBlock (hostThread.buffer, midi);
+                    }
+                    if (p > numWarmUpPeriods)
+                        hostThread.busySeconds += std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+                    periodBarrier.arrive_and_wait();
+                }
+                hostThread.cacheMisses = cacheMisses.stop();
+                isHostThread = false;
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+
+        auto elapsed = std::chrono::duration<double> (periodStart - measureStart).count();
+        step.realtimeFactor = numPeriods * periodSeconds / juce::jmax (elapsed, 1.0e-9);
+        for (auto load : periodLoads)
+        {
+            step.meanLoad += load / (double) periodLoads.size();
+            step.missedDeadlines += load > 1.0 ? 1 : 0;
+        }
+        std::sort (periodLoads.begin(), periodLoads.end());
+        step.p99Load = periodLoads[(size_t) ((double) (periodLoads.size() - 1) * 0.99)];
+
+        auto busySeconds = 0.0;
+        juce::int64 cacheMisses = 0;
+        for (const auto& hostThread : hostThreads)
+        {
+            busySeconds += hostThread.busySeconds;
+            cacheMisses = cacheMisses < 0 || hostThread.cacheMisses < 0 ? -1 : cacheMisses + hostThread.cacheMisses;
+        }
+        auto numInstanceBlocks = (double) numInstances * numPeriods;
+        step.nsPerInstanceBlock = busySeconds * 1.0e9 / numInstanceBlocks;
+        step.hostThreadAllocations = hostThreadAllocations.load() - allocationsBefore;
+        step.cacheMissesPerInstanceBlock = cacheMisses < 0 ? -1.0 : (double) cacheMisses / numInstanceBlocks;
+        return true;
+    }
+
+    juce::var toJSON (const Step& step)
+    {
+        auto* object = new juce::DynamicObject();
+        object->setProperty ("instances", step.numInstances);
+        object->setProperty ("realtimeFactor", step.realtimeFactor);
+        object->setProperty ("meanLoad", step.meanLoad);
+        object->setProperty ("p99Load", step.p99Load);
+        object->setProperty ("missedDeadlines", step.missedDeadlines);
+        object->setProperty ("nsPerInstanceBlock", step.nsPerInstanceBlock);
+        object->setProperty ("bytesPerInstance", step.bytesPerInstance);
+        object->setProperty ("hostThreadAllocations", step.hostThreadAllocations);
+        object->setProperty ("cacheMissesPerInstanceBlock", step.cacheMissesPerInstanceBlock);
+        return object;
+    }
+
+    // realtime factor by instance count of a previous run
+    std::map<int, double> loadBaseline (const juce::File& file)
+    {
+        std::map<int, double> baseline;
+        auto json = juce::JSON::parse (file);
+        if (auto* results = json["results"].getArray())
+            for (const auto& result : *results)
+                baseline[(int) result["instances"]] = (double) result["realtimeFactor"];
+        return baseline;
+    }
+
+    void print (const Step& step, const std::map<int, double>& baseline)
+    {
+        std::cout << std::fixed << std::setprecision (1)
+                  << std::setw (6) << step.numInstances << " instances"
+                  << std::setw (9) << step.realtimeFactor << "x realtime"
+                  << std::setw (7) << step.meanLoad * 100.0 << "% load"
+                  << std::setw (7) << step.p99Load * 100.0 << "% p99"
+                  << std::setw (6) << step.missedDeadlines << " missed"
+                  << std::setw (9) << step.nsPerInstanceBlock / 1000.0 << " us/block"
+                  << std::setw (9) << step.bytesPerInstance / (1024.0 * 1024.0) << " MB/instance"
+                  << std::setw (6) << step.hostThreadAllocations << " allocs";
+        if (step.cacheMissesPerInstanceBlock >= 0.0)
+            std::cout << std::setw (9) << step.cacheMissesPerInstanceBlock << " misses/block";
+        auto previous = baseline.find (step.numInstances);
+        if (previous != baseline.end() && previous->second > 0.0)
+            std::cout << "  (" << std::showpos << (step.realtimeFactor / previous->second - 1.0) * 100.0 << std::noshowpos << "% vs baseline)";
+        std::cout << "\n";
+    }
+}
+
+// clang-format off
+void* operator new (size_t size) { if (auto* ptr = allocate (size)) return ptr; throw std::bad_alloc(); }
+void* operator new[] (size_t size) { if (auto* ptr = allocate (size)) return ptr; throw std::bad_alloc(); }
+void* operator new (size_t size, const std::nothrow_t&) noexcept { return allocate (size); }
+void* operator new[] (size_t size, const std::nothrow_t&) noexcept { return allocate (size); }
+void* operator new (size_t size, std::align_val_t alignment) { if (auto* ptr = allocate (size, static_cast<size_t> (alignment))) return ptr; throw std::bad_alloc(); }
+void* operator new[] (size_t size, std::align_val_t alignment) { if (auto* ptr = allocate (size, static_cast<size_t> (alignment))) return ptr; throw std::bad_alloc(); }
+void* operator new (size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return allocate (size, static_cast<size_t> (alignment)); }
+void* operator new[] (size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return allocate (size, static_cast<size_t> (alignment)); }
+
+void operator delete (void* ptr) noexcept { deallocate (ptr); }
+void operator delete[] (void* ptr) noexcept { deallocate (ptr); }
+void operator delete (void* ptr, size_t) noexcept { deallocate (ptr); }
+void operator delete[] (void* ptr, size_t) noexcept { deallocate (ptr); }
+void operator delete (void* ptr, const std::nothrow_t&) noexcept { deallocate (ptr); }
+void operator delete[] (void* ptr, const std::nothrow_t&) noexcept { deallocate (ptr); }
+void operator delete (void* ptr, std::align_val_t) noexcept { deallocate (ptr); }
+void operator delete[] (void* ptr, std::align_val_t) noexcept { deallocate (ptr); }
+void operator delete (void* ptr, size_t, std::align_val_t) noexcept { deallocate (ptr); }
+void operator delete[] (void* ptr, size_t, std::align_val_t) noexcept { deallocate (ptr); }
+void operator delete (void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { deallocate (ptr); }
+void operator delete[] (void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { deallocate (ptr); }
+// clang-format on
+
+int main (int argc, char* argv[])
+{
+    Options options;
+    juce::StringArray arguments;
+    for (int i = 1; i < argc; i++)
+        arguments.add (juce::CharPointer_UTF8 (argv[i]));
+
+    if (!parseArguments (arguments, options))
+    {
+        printUsage();
+        return 1;
+    }
+
+    // the processors' apvts wants a message manager
+    auto gui = juce::ScopedJuceInitialiser_GUI {};
+    auto baseline = options.compareWith == juce::File() ? std::map<int, double> {} : loadBaseline (options.compareWith);
+
+    // a few seconds of noise all instances play, looped
+    juce::AudioBuffer<float> input (2, (int) (4.0 * options.sampleRate) + options.blockSize);
+    juce::Random random (42);
+    for (int channel = 0; channel < input.getNumChannels(); channel++)
+        for (int i = 0; i < input.getNumSamples(); i++)
+            input.setSample (channel, i, random.nextFloat() * 2.0f - 1.0f);
+
+    std::cout << options.numThreads << " host threads, " << options.sampleRate << " Hz, "
+              << options.blockSize << " samples per period, " << options.seconds << " s per step\n";
+    juce::Array<juce::var> results;
+    for (auto numInstances : options.instanceCounts)
+    {
+        Step step;
+        if (!run (options, numInstances, input, step))
+            return 1;
+        print (step, baseline);
+        results.add (toJSON (step));
+    }
+
+    auto* report = new juce::DynamicObject();
+    report->setProperty ("version", VERSION);
+    report->setProperty ("buildType", CMAKE_BUILD_TYPE);
+    report->setProperty ("threads", options.numThreads);
+    report->setProperty ("sampleRate", options.sampleRate);
+    report->setProperty ("blockSize", options.blockSize);
+    report->setProperty ("secondsPerStep", options.seconds);
+    report->setProperty ("results", results);
+    if (!options.output.replaceWithText (juce::JSON::toString (juce::var (report))))
+    {
+        std::cerr << "can't write " << options.output.getFullPathName() << "\n";
+        return 1;
+    }
+    std::cout << "wrote " << options.output.getFullPathName() << "\n";
+    return 0;
+}